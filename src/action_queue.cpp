@@ -0,0 +1,186 @@
+/*
+ * Copyright © 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "action_queue.h"
+
+#include <stdexcept>
+#include <boost/throw_exception.hpp>
+
+namespace
+{
+
+bool is_power_of_two(std::size_t n)
+{
+    return n != 0 && (n & (n - 1)) == 0;
+}
+
+}
+
+usc::ActionQueue::ActionQueue(std::size_t capacity)
+    : mask{capacity - 1},
+      ring{new Slot[capacity]},
+      enqueue_pos{0},
+      dequeue_pos{0},
+      pending{0},
+      overflowing{false}
+{
+    if (!is_power_of_two(capacity))
+        BOOST_THROW_EXCEPTION(std::logic_error("ActionQueue capacity must be a power of two"));
+
+    for (std::size_t i = 0; i < capacity; ++i)
+        ring[i].sequence.store(i, std::memory_order_relaxed);
+}
+
+usc::ActionQueue::~ActionQueue() = default;
+
+bool usc::ActionQueue::push(Task&& action)
+{
+    // Once we have spilled over, keep using the overflow list until the
+    // consumer has drained it, so that actions stay in FIFO order
+    while (true)
+    {
+        if (overflowing.load(std::memory_order_acquire))
+        {
+            if (push_to_overflow(action))
+                break;
+        }
+        else if (try_push_to_ring(action))
+        {
+            break;
+        }
+        else
+        {
+            std::lock_guard<std::mutex> lock{overflow_mutex};
+            overflowing.store(true, std::memory_order_release);
+            overflow.push_back(std::move(action));
+            break;
+        }
+    }
+
+    return mark_pushed();
+}
+
+bool usc::ActionQueue::dispatch()
+{
+    // Only run actions that were queued before we started, actions
+    // queued by the actions themselves are left for the next dispatch
+    auto const limit = enqueue_pos.load(std::memory_order_acquire);
+    int64_t dispatched{0};
+
+    Task action;
+    while (try_pop_from_ring(limit, action))
+    {
+        ++dispatched;
+        action();
+        action.reset();
+    }
+
+    if (overflowing.load(std::memory_order_acquire))
+    {
+        std::deque<Task> overflowed;
+        {
+            std::lock_guard<std::mutex> lock{overflow_mutex};
+
+            // Actions in the ring that we haven't got to, because they were
+            // pushed after we started or are still being written, may be
+            // older than the overflowed ones. The overflow list waits for
+            // the next dispatch in that case.
+            if (enqueue_pos.load(std::memory_order_acquire) == dequeue_pos)
+            {
+                overflowed.swap(overflow);
+                overflowing.store(false, std::memory_order_release);
+            }
+        }
+
+        for (auto& overflowed_action : overflowed)
+        {
+            ++dispatched;
+            overflowed_action();
+        }
+    }
+
+    // Producers only wake us up when they see the queue go from empty to
+    // non-empty. If actions were counted as pushed but not dispatched,
+    // their producers won't wake us up again, so the caller has to.
+    auto const remaining =
+        pending.fetch_sub(dispatched, std::memory_order_acq_rel) - dispatched;
+
+    return remaining > 0;
+}
+
+bool usc::ActionQueue::try_push_to_ring(Task& action)
+{
+    auto pos = enqueue_pos.load(std::memory_order_relaxed);
+    Slot* slot;
+
+    while (true)
+    {
+        slot = &ring[pos & mask];
+        auto const sequence = slot->sequence.load(std::memory_order_acquire);
+        auto const diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+
+        if (diff == 0)
+        {
+            if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if (diff < 0)
+        {
+            return false;
+        }
+        else
+        {
+            pos = enqueue_pos.load(std::memory_order_relaxed);
+        }
+    }
+
+    slot->action = std::move(action);
+    slot->sequence.store(pos + 1, std::memory_order_release);
+
+    return true;
+}
+
+bool usc::ActionQueue::try_pop_from_ring(std::size_t limit, Task& action)
+{
+    if (dequeue_pos == limit)
+        return false;
+
+    auto& slot = ring[dequeue_pos & mask];
+    if (slot.sequence.load(std::memory_order_acquire) != dequeue_pos + 1)
+        return false;
+
+    action = std::move(slot.action);
+    slot.sequence.store(dequeue_pos + mask + 1, std::memory_order_release);
+    ++dequeue_pos;
+
+    return true;
+}
+
+bool usc::ActionQueue::push_to_overflow(Task& action)
+{
+    std::lock_guard<std::mutex> lock{overflow_mutex};
+
+    if (!overflowing.load(std::memory_order_relaxed))
+        return false;
+
+    overflow.push_back(std::move(action));
+    return true;
+}
+
+bool usc::ActionQueue::mark_pushed()
+{
+    return pending.fetch_add(1, std::memory_order_acq_rel) == 0;
+}
@@ -0,0 +1,87 @@
+/*
+ * Copyright © 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef USC_ACTION_QUEUE_H_
+#define USC_ACTION_QUEUE_H_
+
+#include "task.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+
+namespace usc
+{
+
+/*
+ * Lock-free multi-producer/single-consumer queue of actions.
+ *
+ * Actions are stored in a preallocated ring of Task slots, so in the
+ * steady state neither pushing nor dispatching allocates. Producers claim
+ * slots with a single CAS. If the ring is full, actions spill over into a
+ * locked overflow list until the consumer catches up.
+ *
+ * push() reports whether it moved the queue from empty to non-empty, so
+ * that only one producer per batch needs to wake the consumer.
+ */
+class ActionQueue
+{
+public:
+    static std::size_t const default_capacity = 256;
+
+    explicit ActionQueue(std::size_t capacity = default_capacity);
+    ~ActionQueue();
+
+    bool push(Task&& action);
+
+    // Runs the actions queued before the call, except for overflowed
+    // actions queued behind ring slots still being written. Returns whether
+    // there are still actions left whose producers relied on this dispatch.
+    bool dispatch();
+
+private:
+    ActionQueue(ActionQueue const&) = delete;
+    ActionQueue& operator=(ActionQueue const&) = delete;
+
+    struct Slot
+    {
+        std::atomic<std::size_t> sequence;
+        Task action;
+    };
+
+    bool try_push_to_ring(Task& action);
+    bool try_pop_from_ring(std::size_t limit, Task& action);
+    bool push_to_overflow(Task& action);
+    bool mark_pushed();
+
+    std::size_t const mask;
+    std::unique_ptr<Slot[]> const ring;
+    std::atomic<std::size_t> enqueue_pos;
+    std::size_t dequeue_pos;
+
+    std::atomic<int64_t> pending;
+
+    std::atomic<bool> overflowing;
+    std::mutex overflow_mutex;
+    std::deque<Task> overflow;
+};
+
+}
+
+#endif
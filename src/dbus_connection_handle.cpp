@@ -23,6 +23,18 @@
 #include <boost/throw_exception.hpp>
 
 usc::DBusConnectionHandle::DBusConnectionHandle(std::string const& address)
+    : DBusConnectionHandle{address, PeerToPeer{}}
+{
+    ScopedDBusError error;
+
+    if (!dbus_bus_register(connection, &error))
+    {
+        BOOST_THROW_EXCEPTION(
+            std::runtime_error("dbus_bus_register: " + error.message_str()));
+    }
+}
+
+usc::DBusConnectionHandle::DBusConnectionHandle(std::string const& address, PeerToPeer)
 {
     dbus_threads_init_default();
     ScopedDBusError error;
@@ -33,12 +45,11 @@ usc::DBusConnectionHandle::DBusConnectionHandle(std::string const& address)
         BOOST_THROW_EXCEPTION(
             std::runtime_error("dbus_connection_open: " + error.message_str()));
     }
+}
 
-    if (!dbus_bus_register(connection, &error))
-    {
-        BOOST_THROW_EXCEPTION(
-            std::runtime_error("dbus_bus_register: " + error.message_str()));
-    }
+usc::DBusConnectionHandle::DBusConnectionHandle(::DBusConnection* connection)
+    : connection{dbus_connection_ref(connection)}
+{
 }
 
 usc::DBusConnectionHandle::~DBusConnectionHandle()
@@ -96,6 +107,27 @@ void usc::DBusConnectionHandle::add_filter(
     }
 }
 
+void usc::DBusConnectionHandle::register_object_path(
+    char const* path,
+    DBusObjectPathMessageFunction handler,
+    void* user_data) const
+{
+    ScopedDBusError error;
+    DBusObjectPathVTable const vtable{nullptr, handler, nullptr, nullptr, nullptr, nullptr};
+
+    dbus_connection_try_register_object_path(connection, path, &vtable, user_data, &error);
+    if (error)
+    {
+        BOOST_THROW_EXCEPTION(
+            std::runtime_error("dbus_connection_try_register_object_path: " + error.message_str()));
+    }
+}
+
+void usc::DBusConnectionHandle::unregister_object_path(char const* path) const
+{
+    dbus_connection_unregister_object_path(connection, path);
+}
+
 usc::DBusConnectionHandle::operator ::DBusConnection*() const
 {
     return connection;
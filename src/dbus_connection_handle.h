@@ -29,12 +29,24 @@ namespace usc
 class DBusConnectionHandle
 {
 public:
+    struct PeerToPeer {};
+
+    // Connects to the message bus at address
     DBusConnectionHandle(std::string const& address);
+    // Connects directly to a peer, e.g. a DBusPeerServer, without a bus
+    DBusConnectionHandle(std::string const& address, PeerToPeer);
+    // Takes a new reference to an already open connection
+    explicit DBusConnectionHandle(::DBusConnection* connection);
     ~DBusConnectionHandle();
 
     void request_name(char const* name) const;
     void add_match(char const* match) const;
     void add_filter(DBusHandleMessageFunction filter_func, void* user_data) const;
+    // Unlike filters, object path handlers only see messages sent to their path,
+    // so several services can share a connection
+    void register_object_path(
+        char const* path, DBusObjectPathMessageFunction handler, void* user_data) const;
+    void unregister_object_path(char const* path) const;
 
     operator ::DBusConnection*() const;
 
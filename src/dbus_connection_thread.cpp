@@ -20,28 +20,45 @@
 #include "dbus_event_loop.h"
 #include "thread_name.h"
 
-usc::DBusConnectionThread::DBusConnectionThread(std::shared_ptr<DBusEventLoop> const& loop) : dbus_event_loop(loop)
+usc::DBusConnectionThread::DBusConnectionThread(std::shared_ptr<DBusEventLoop> const& loop)
+    : DBusConnectionThread(std::vector<std::shared_ptr<DBusEventLoop>>{loop})
 {
-    std::promise<void> event_loop_started;
-    auto event_loop_started_future = event_loop_started.get_future();
+}
+
+usc::DBusConnectionThread::DBusConnectionThread(
+    std::vector<std::shared_ptr<DBusEventLoop>> const& loops)
+    : dbus_event_loops(loops)
+{
+    for (auto const& dbus_event_loop : dbus_event_loops)
+    {
+        auto const thread_name = dbus_loop_threads.empty() ?
+            std::string{"USC/DBus"} :
+            "USC/DBus/" + std::to_string(dbus_loop_threads.size());
 
-    dbus_loop_thread = std::thread(
-        [this,&event_loop_started]
-        {
-            usc::set_thread_name("USC/DBus");
-            dbus_event_loop->run(event_loop_started);
-        });
+        std::promise<void> event_loop_started;
+        auto event_loop_started_future = event_loop_started.get_future();
 
-    event_loop_started_future.wait();
+        dbus_loop_threads.emplace_back(
+            [&dbus_event_loop,&thread_name,&event_loop_started]
+            {
+                usc::set_thread_name(thread_name);
+                dbus_event_loop->run(event_loop_started);
+            });
+
+        event_loop_started_future.wait();
+    }
 }
 
 usc::DBusConnectionThread::~DBusConnectionThread()
 {
-    dbus_event_loop->stop();
-    dbus_loop_thread.join();
+    for (auto const& dbus_event_loop : dbus_event_loops)
+        dbus_event_loop->stop();
+
+    for (auto& dbus_loop_thread : dbus_loop_threads)
+        dbus_loop_thread.join();
 }
 
 usc::DBusEventLoop & usc::DBusConnectionThread::loop()
 {
-    return *dbus_event_loop;
+    return *dbus_event_loops.front();
 }
@@ -19,22 +19,27 @@
 #ifndef USC_DBUS_CONNECTION_THREAD_H_
 #define USC_DBUS_CONNECTION_THREAD_H_
 
+#include <memory>
 #include <thread>
+#include <vector>
 
 namespace usc
 {
 
 class DBusEventLoop;
+
+// Runs each of the given event loops on a thread of its own
 class DBusConnectionThread
 {
 public:
     DBusConnectionThread(std::shared_ptr<DBusEventLoop> const& thread);
+    DBusConnectionThread(std::vector<std::shared_ptr<DBusEventLoop>> const& loops);
     ~DBusConnectionThread();
     DBusEventLoop & loop();
 
 private:
-    std::shared_ptr<DBusEventLoop> dbus_event_loop;
-    std::thread dbus_loop_thread;
+    std::vector<std::shared_ptr<DBusEventLoop>> const dbus_event_loops;
+    std::vector<std::thread> dbus_loop_threads;
 };
 
 }
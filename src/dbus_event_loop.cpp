@@ -23,12 +23,13 @@
 #include "dbus_event_loop.h"
 #include "dbus_connection_handle.h"
 
+#include <mir/log.h>
+
 #include <algorithm>
 
 #include <sys/epoll.h>
-#include <sys/timerfd.h>
+#include <sys/eventfd.h>
 #include <unistd.h>
-#include <fcntl.h>
 
 #include <system_error>
 #include <boost/throw_exception.hpp>
@@ -36,6 +37,17 @@
 namespace
 {
 
+void log_histogram(char const* name, usc::Histogram::Snapshot const& histogram)
+{
+    mir::log(::mir::logging::Severity::informational, "usc::DBusEventLoop",
+             "  %s: %llu samples, p50 <= %llu, p99 <= %llu, max %llu",
+             name,
+             static_cast<unsigned long long>(histogram.samples),
+             static_cast<unsigned long long>(histogram.percentile(0.5)),
+             static_cast<unsigned long long>(histogram.percentile(0.99)),
+             static_cast<unsigned long long>(histogram.max));
+}
+
 uint32_t dbus_flags_to_epoll_events(DBusWatch* bus_watch)
 {
     unsigned int flags;
@@ -69,19 +81,26 @@ unsigned int epoll_events_to_dbus_flags(uint32_t events)
     return flags;
 }
 
-timespec msec_to_timespec(int msec)
+int const max_epoll_events = 16;
+
+uint64_t microseconds_since(usc::TimerQueue::Clock::time_point start)
 {
-    static long const milli_to_nano = 1000000;
-    time_t const sec = msec / 1000;
-    long const nsec = (msec % 1000) * milli_to_nano;
-    return timespec{sec, nsec};
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        usc::TimerQueue::Clock::now() - start).count();
 }
 
 }
 
-usc::DBusEventLoop::DBusEventLoop()
+std::chrono::milliseconds const usc::DBusEventLoop::default_stall_threshold{100};
+
+usc::DBusEventLoop::DBusEventLoop(std::chrono::milliseconds stall_threshold)
     : running{false},
-      epoll_fd{epoll_create1(EPOLL_CLOEXEC)}
+      in_run{false},
+      coalesced_wake_ups_{0},
+      stall_threshold{stall_threshold},
+      stalled_iterations{0},
+      epoll_fd{epoll_create1(EPOLL_CLOEXEC)},
+      wake_up_fd{eventfd(0, EFD_CLOEXEC|EFD_NONBLOCK)}
 {
     if (epoll_fd == -1)
     {
@@ -89,41 +108,50 @@ usc::DBusEventLoop::DBusEventLoop()
             std::system_error(errno, std::system_category(), "epoll_create1"));
     }
 
-    int pipefd[2]{};
-
-    if (pipe2(pipefd, O_CLOEXEC) == -1)
+    if (wake_up_fd == -1)
     {
         BOOST_THROW_EXCEPTION(
-            std::system_error(errno, std::system_category(), "pipe2"));
-
+            std::system_error(errno, std::system_category(), "eventfd"));
     }
 
-    wake_up_fd_r = mir::Fd{pipefd[0]};
-    wake_up_fd_w = mir::Fd{pipefd[1]};
-
-    epoll_event ev{};
-    ev.data.fd = wake_up_fd_r;
-    ev.events = EPOLLIN;
-    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, ev.data.fd, &ev) == -1)
+    for (int const fd : {int{wake_up_fd}, timer_queue.fd()})
     {
-        BOOST_THROW_EXCEPTION(
-            std::system_error(errno, std::system_category(), "epoll_ctl"));
+        epoll_event ev{};
+        ev.data.fd = fd;
+        ev.events = EPOLLIN;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, ev.data.fd, &ev) == -1)
+        {
+            BOOST_THROW_EXCEPTION(
+                std::system_error(errno, std::system_category(), "epoll_ctl"));
+        }
     }
 }
 
-void usc::DBusEventLoop::add_connection(std::shared_ptr<DBusConnectionHandle> const& connection)
+void usc::DBusEventLoop::add_connection(
+    std::shared_ptr<DBusConnectionHandle> const& connection,
+    Priority priority)
 {
-    if (running)
-        BOOST_THROW_EXCEPTION(std::logic_error("Connection added after dbus event loop started"));
+    ensure_connections_can_change();
 
-    connections.push_back(connection);
+    auto const added = std::find_if(begin(connections), end(connections),
+        [&connection] (std::unique_ptr<Connection> const& c) { return c->handle == connection; });
+    if (added != end(connections))
+    {
+        ++(*added)->users;
+        if (priority == Priority::high && (*added)->priority != Priority::high)
+            raise_priority(**added);
+        return;
+    }
+
+    connections.push_back(
+        std::unique_ptr<Connection>{new Connection{this, connection, priority, 1}});
 
     dbus_connection_set_watch_functions(
         *connection,
         DBusEventLoop::static_add_watch,
         DBusEventLoop::static_remove_watch,
         DBusEventLoop::static_toggle_watch,
-        this,
+        connections.back().get(),
         nullptr);
 
     dbus_connection_set_timeout_functions(
@@ -138,34 +166,173 @@ void usc::DBusEventLoop::add_connection(std::shared_ptr<DBusConnectionHandle> co
         *connection,
         DBusEventLoop::static_wake_up_loop,
         this, nullptr);
+
+    dbus_connection_set_dispatch_status_function(
+        *connection,
+        DBusEventLoop::static_dispatch_status_changed,
+        connections.back().get(), nullptr);
+
+    // Messages may already be queued on the connection, and nothing else
+    // makes the loop look at it until another event arrives
+    wake_up_loop();
+}
+
+void usc::DBusEventLoop::remove_connection(
+    std::shared_ptr<DBusConnectionHandle> const& connection)
+{
+    // If the loop stops first, its destructor stops watching the connection
+    if (running && std::this_thread::get_id() != loop_thread)
+    {
+        enqueue(Priority::high, [this, connection] { remove_connection(connection); });
+        return;
+    }
+
+    auto const iter = std::find_if(begin(connections), end(connections),
+        [&connection] (std::unique_ptr<Connection> const& c) { return c->handle == connection; });
+    if (iter == end(connections) || --(*iter)->users > 0)
+        return;
+
+    stop_watching(*connection);
+    connections.erase(iter);
+}
+
+usc::DBusEventLoop::Priority usc::DBusEventLoop::priority_of(
+    std::shared_ptr<DBusConnectionHandle> const& connection)
+{
+    ensure_connections_can_change();
+
+    auto const iter = std::find_if(begin(connections), end(connections),
+        [&connection] (std::unique_ptr<Connection> const& c) { return c->handle == connection; });
+    if (iter == end(connections))
+        BOOST_THROW_EXCEPTION(std::logic_error("Connection isn't in the dbus event loop"));
+
+    return (*iter)->priority;
+}
+
+void usc::DBusEventLoop::raise_priority(Connection& connection)
+{
+    connection.priority = Priority::high;
+
+    // Watches added from now on take the new priority from the
+    // connection, those already added have to be told
+    int fd{-1};
+    if (!dbus_connection_get_unix_fd(*connection.handle, &fd))
+        return;
+
+    std::lock_guard<std::mutex> lock{mutex};
+    auto const iter = watches.find(fd);
+    if (iter != watches.end())
+        iter->second.priority = Priority::high;
+}
+
+void usc::DBusEventLoop::add_server(DBusServer* server, Priority priority)
+{
+    if (running)
+        BOOST_THROW_EXCEPTION(std::logic_error("Server added after dbus event loop started"));
+
+    servers.push_back(
+        std::unique_ptr<Server>{new Server{this, server, priority}});
+
+    auto const watches_set = dbus_server_set_watch_functions(
+        server,
+        DBusEventLoop::static_add_server_watch,
+        DBusEventLoop::static_remove_server_watch,
+        DBusEventLoop::static_toggle_server_watch,
+        servers.back().get(),
+        nullptr);
+
+    auto const timeouts_set = dbus_server_set_timeout_functions(
+        server,
+        DBusEventLoop::static_add_timeout,
+        DBusEventLoop::static_remove_timeout,
+        DBusEventLoop::static_toggle_timeout,
+        this,
+        nullptr);
+
+    if (!watches_set || !timeouts_set)
+    {
+        stop_watching(server);
+        servers.pop_back();
+        BOOST_THROW_EXCEPTION(std::runtime_error("Failed to watch dbus server"));
+    }
+}
+
+void usc::DBusEventLoop::remove_server(DBusServer* server)
+{
+    if (running)
+        BOOST_THROW_EXCEPTION(std::logic_error("Server removed while dbus event loop is running"));
+
+    auto const iter = std::find_if(begin(servers), end(servers),
+        [server] (std::unique_ptr<Server> const& s) { return s->server == server; });
+    if (iter == end(servers))
+        return;
+
+    stop_watching(server);
+    servers.erase(iter);
 }
 
 usc::DBusEventLoop::~DBusEventLoop()
 {
     stop();
 
-    for(auto connection : connections)
-    {
-        dbus_connection_set_watch_functions(
-            *connection, nullptr, nullptr, nullptr, nullptr, nullptr);
+    for (auto const& connection : connections)
+        stop_watching(*connection->handle);
 
-        dbus_connection_set_timeout_functions(
-            *connection, nullptr, nullptr, nullptr, nullptr, nullptr);
+    for (auto const& server : servers)
+        stop_watching(server->server);
+}
 
-        dbus_connection_set_wakeup_main_function(
-            *connection, nullptr, nullptr, nullptr);
+void usc::DBusEventLoop::ensure_connections_can_change()
+{
+    // The loop iterates over the connections without holding a lock
+    if (running && std::this_thread::get_id() != loop_thread)
+    {
+        BOOST_THROW_EXCEPTION(
+            std::logic_error("Dbus event loop connections changed from outside the loop thread"));
     }
 }
 
+void usc::DBusEventLoop::stop_watching(DBusConnection* connection)
+{
+    dbus_connection_set_watch_functions(
+        connection, nullptr, nullptr, nullptr, nullptr, nullptr);
+
+    dbus_connection_set_timeout_functions(
+        connection, nullptr, nullptr, nullptr, nullptr, nullptr);
+
+    dbus_connection_set_wakeup_main_function(
+        connection, nullptr, nullptr, nullptr);
+
+    dbus_connection_set_dispatch_status_function(
+        connection, nullptr, nullptr, nullptr);
+}
+
+void usc::DBusEventLoop::stop_watching(DBusServer* server)
+{
+    dbus_server_set_watch_functions(
+        server, nullptr, nullptr, nullptr, nullptr, nullptr);
+
+    dbus_server_set_timeout_functions(
+        server, nullptr, nullptr, nullptr, nullptr, nullptr);
+}
+
 void usc::DBusEventLoop::run(std::promise<void>& started)
 {
+    loop_thread = std::this_thread::get_id();
     running = true;
+    {
+        std::lock_guard<std::mutex> lock{drain_mutex};
+        in_run = true;
+    }
     started.set_value();
 
+    auto wake_up_window_start = TimerQueue::Clock::now();
+    uint64_t wake_ups_in_window{0};
+
     while (running)
     {
-        epoll_event event{};
-        int n = epoll_wait(epoll_fd, &event, 1, -1);
+        epoll_event events[max_epoll_events];
+        int n = epoll_wait(epoll_fd, events, max_epoll_events, -1);
         if (n == -1)
         {
             if (errno == EINTR)
@@ -175,40 +342,48 @@ void usc::DBusEventLoop::run(std::promise<void>& started)
                 std::system_error(errno, std::system_category(), "epoll_wait"));
         }
 
-        if (event.data.fd == wake_up_fd_r)
+        auto const iteration_start = TimerQueue::Clock::now();
+
+        if (iteration_start - wake_up_window_start >= std::chrono::seconds{1})
         {
-            char c;
-            if (read(event.data.fd, &c, 1));
+            if (wake_ups_in_window > 0)
+                wake_ups_per_second.record(wake_ups_in_window);
+            wake_up_window_start = iteration_start;
+            wake_ups_in_window = 0;
         }
-        else
-        {
-            auto const& matching_watches = enabled_watches_for(event.data.fd);
-            for (auto const& watch : matching_watches)
-            {
-                dbus_watch_handle(watch, epoll_events_to_dbus_flags(event.events));
-            }
+        ++wake_ups_in_window;
 
-            if (matching_watches.empty())
-            {
-                auto timeout = enabled_timeout_for(event.data.fd);
-                if (timeout)
-                    dbus_timeout_handle(timeout);
-            }
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+
+            // Read from high priority connections first
+            std::stable_partition(events, events + n,
+                [this] (epoll_event const& event)
+                {
+                    return is_high_priority_fd(event.data.fd);
+                });
         }
 
-        dispatch_actions();
+        for (int i = 0; i < n; ++i)
+            handle_event(events[i].data.fd, events[i].events);
 
-        for (auto connection : connections)
-        {
-            dbus_connection_flush(*connection);
+        dispatch_actions(Priority::high);
+        dispatch_connections(Priority::high);
+        dispatch_actions(Priority::normal);
+        dispatch_connections(Priority::normal);
 
-            while (dbus_connection_dispatch(*connection) == DBUS_DISPATCH_DATA_REMAINS);
-        }
+        check_for_stall(iteration_start);
     }
 
     // Flush any remaining outgoing messages
-    for (auto connection : connections)
-        dbus_connection_flush(*connection);
+    for (auto const& connection : connections)
+        dbus_connection_flush(*connection->handle);
+
+    {
+        std::lock_guard<std::mutex> lock{drain_mutex};
+        in_run = false;
+    }
+    drained.notify_all();
 }
 
 void usc::DBusEventLoop::stop()
@@ -217,38 +392,58 @@ void usc::DBusEventLoop::stop()
     wake_up_loop();
 }
 
-std::vector<DBusWatch*> usc::DBusEventLoop::enabled_watches_for(int fd)
+void usc::DBusEventLoop::handle_event(int fd, uint32_t events)
 {
-    std::lock_guard<std::mutex> lock{mutex};
-
-    std::vector<DBusWatch*> ret_watches;
+    if (fd == wake_up_fd)
+    {
+        // A single read consumes all wake-ups requested since the last one
+        eventfd_t wake_ups{0};
+        if (eventfd_read(fd, &wake_ups) == 0 && wake_ups > 1)
+            coalesced_wake_ups_.fetch_add(wake_ups - 1, std::memory_order_relaxed);
+        return;
+    }
 
-    for (auto const& w : watches)
+    if (fd == timer_queue.fd())
     {
-        if (dbus_watch_get_unix_fd(w) == fd &&
-            dbus_watch_get_enabled(w))
-        {
-            ret_watches.push_back(w);
-        }
+        timer_queue.dispatch_expired();
+        return;
     }
 
-    return ret_watches;
+    // Watches may be removed by the handlers of earlier events in the
+    // same batch, so look them up right before handling.
+    enabled_watches_for(fd, ready_watches);
+
+    for (auto const& watch : ready_watches)
+        dbus_watch_handle(watch, epoll_events_to_dbus_flags(events));
+}
+
+bool usc::DBusEventLoop::is_high_priority_fd(int fd)
+{
+    // The loop's own wake-up and timer fds are cheap to handle, so they
+    // are treated as high priority too
+    auto const iter = watches.find(fd);
+    return iter == watches.end() || iter->second.priority == Priority::high;
 }
 
-DBusTimeout* usc::DBusEventLoop::enabled_timeout_for(int fd)
+void usc::DBusEventLoop::enabled_watches_for(
+    int fd, std::vector<DBusWatch*>& enabled_watches)
 {
     std::lock_guard<std::mutex> lock{mutex};
 
-    for (auto const& p : timeouts)
+    enabled_watches.clear();
+
+    auto const watches_iter = watches.find(fd);
+    if (watches_iter != watches.end())
     {
-        if (p.second == fd && dbus_timeout_get_enabled(p.first))
-            return p.first;
+        for (auto const& w : watches_iter->second.watches)
+        {
+            if (dbus_watch_get_enabled(w))
+                enabled_watches.push_back(w);
+        }
     }
-
-    return nullptr;
 }
 
-dbus_bool_t usc::DBusEventLoop::add_watch(DBusWatch* watch)
+dbus_bool_t usc::DBusEventLoop::add_watch(DBusWatch* watch, Priority priority)
 {
     std::lock_guard<std::mutex> lock{mutex};
 
@@ -262,7 +457,10 @@ dbus_bool_t usc::DBusEventLoop::add_watch(DBusWatch* watch)
             return FALSE;
     }
 
-    watches.push_back(watch);
+    auto& watched_fd = watches[watch_fd];
+    if (watched_fd.watches.empty() || priority == Priority::high)
+        watched_fd.priority = priority;
+    watched_fd.watches.push_back(watch);
 
     update_events_for_watch_fd(watch_fd);
 
@@ -273,13 +471,24 @@ void usc::DBusEventLoop::remove_watch(DBusWatch* watch)
 {
     std::lock_guard<std::mutex> lock{mutex};
 
-    watches.erase(std::remove(begin(watches), end(watches), watch), end(watches));
-
     int const watch_fd = dbus_watch_get_unix_fd(watch);
-    if (!is_watched(watch_fd))
+
+    auto const iter = watches.find(watch_fd);
+    if (iter == watches.end())
+        return;
+
+    auto& fd_watches = iter->second.watches;
+    fd_watches.erase(std::remove(begin(fd_watches), end(fd_watches), watch), end(fd_watches));
+
+    if (fd_watches.empty())
+    {
+        watches.erase(iter);
         epoll_ctl(epoll_fd, EPOLL_CTL_DEL, watch_fd, nullptr);
+    }
     else
+    {
         update_events_for_watch_fd(watch_fd);
+    }
 }
 
 void usc::DBusEventLoop::toggle_watch(DBusWatch* watch)
@@ -300,22 +509,19 @@ void usc::DBusEventLoop::update_events_for_watch_fd(int watch_fd)
 
 bool usc::DBusEventLoop::is_watched(int watch_fd)
 {
-    auto const iter = std::find_if(
-        begin(watches), end(watches),
-        [watch_fd] (DBusWatch* w) { return dbus_watch_get_unix_fd(w) == watch_fd; });
-
-    return iter != end(watches);
+    return watches.find(watch_fd) != watches.end();
 }
 
 uint32_t usc::DBusEventLoop::epoll_events_for_watch_fd(int fd)
 {
     uint32_t events{};
 
-    for (auto const& watch : watches)
-    {
-        if (dbus_watch_get_unix_fd(watch) == fd)
-            events |= dbus_flags_to_epoll_events(watch);
-    }
+    auto const iter = watches.find(fd);
+    if (iter == watches.end())
+        return events;
+
+    for (auto const& watch : iter->second.watches)
+        events |= dbus_flags_to_epoll_events(watch);
 
     return events;
 }
@@ -324,117 +530,264 @@ dbus_bool_t usc::DBusEventLoop::add_timeout(DBusTimeout* timeout)
 {
     std::lock_guard<std::mutex> lock{mutex};
 
-    auto tfd = mir::Fd{timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK|TFD_CLOEXEC)};
+    timeouts[timeout] = 0;
 
-    epoll_event ev{};
-    ev.events = EPOLLIN;
-    ev.data.fd = tfd;
-
-    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, tfd, &ev))
+    try
+    {
+        schedule_timeout(timeout);
+    }
+    catch (std::exception const&)
+    {
+        timeouts.erase(timeout);
         return FALSE;
+    }
 
-    timeouts.emplace_back(timeout, std::move(tfd));
-
-    return update_timer_fd_for(timeout);
+    return TRUE;
 }
 
 void usc::DBusEventLoop::remove_timeout(DBusTimeout* timeout)
 {
     std::lock_guard<std::mutex> lock{mutex};
 
-    auto tfd = timer_fd_for(timeout);
-    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, tfd, nullptr);
-
-    timeouts.erase(
-        std::remove_if(begin(timeouts), end(timeouts),
-            [timeout] (decltype(timeouts)::const_reference p)
-            {
-                return p.first == timeout;
-            }),
-        end(timeouts));
+    auto const iter = timeouts.find(timeout);
+    if (iter == timeouts.end())
+        return;
 
+    timer_queue.cancel(iter->second);
+    timeouts.erase(iter);
 }
 
 void usc::DBusEventLoop::toggle_timeout(DBusTimeout* timeout)
 {
     std::lock_guard<std::mutex> lock{mutex};
-    update_timer_fd_for(timeout);
-}
 
+    auto const iter = timeouts.find(timeout);
+    if (iter == timeouts.end())
+        return;
+
+    timer_queue.cancel(iter->second);
+    iter->second = 0;
 
-dbus_bool_t usc::DBusEventLoop::update_timer_fd_for(DBusTimeout* timeout)
+    try
+    {
+        schedule_timeout(timeout);
+    }
+    catch (std::exception const&)
+    {
+    }
+}
+
+void usc::DBusEventLoop::schedule_timeout(DBusTimeout* timeout)
 {
-    itimerspec spec{};
+    if (!dbus_timeout_get_enabled(timeout))
+        return;
+
+    auto const deadline = TimerQueue::Clock::now() +
+        std::chrono::milliseconds{dbus_timeout_get_interval(timeout)};
 
-    auto tfd = timer_fd_for(timeout);
+    timeouts[timeout] = timer_queue.schedule(
+        deadline, [this,timeout] { handle_timeout(timeout); });
+}
 
-    if (dbus_timeout_get_enabled(timeout))
+void usc::DBusEventLoop::handle_timeout(DBusTimeout* timeout)
+{
     {
-        spec.it_interval = msec_to_timespec(dbus_timeout_get_interval(timeout));
-        spec.it_value = spec.it_interval;
+        std::lock_guard<std::mutex> lock{mutex};
+
+        auto const iter = timeouts.find(timeout);
+        if (iter == timeouts.end())
+            return;
+
+        iter->second = 0;
+
+        if (!dbus_timeout_get_enabled(timeout))
+            return;
+
+        // DBus timeouts are periodic until they are removed or disabled
+        try
+        {
+            schedule_timeout(timeout);
+        }
+        catch (std::exception const&)
+        {
+        }
     }
 
-    if (timerfd_settime(tfd, 0, &spec, nullptr) == -1)
-        return FALSE;
+    dbus_timeout_handle(timeout);
+}
 
-    return TRUE;
+void usc::DBusEventLoop::wake_up_loop()
+{
+    // This only fails with EAGAIN if the counter is about to overflow, in
+    // which case the loop has plenty of pending wake-ups already
+    eventfd_write(wake_up_fd, 1);
+}
+
+bool usc::DBusEventLoop::cancel(DelayedActionId id)
+{
+    return timer_queue.cancel(id);
 }
 
-int usc::DBusEventLoop::timer_fd_for(DBusTimeout* timeout)
+void usc::DBusEventLoop::drain(Priority priority)
 {
-    auto iter = std::find_if(begin(timeouts), end(timeouts),
-        [timeout] (std::pair<DBusTimeout*,int> const& p)
+    if (std::this_thread::get_id() == loop_thread)
+        return;
+
+    std::unique_lock<std::mutex> lock{drain_mutex};
+    if (!in_run)
+        return;
+
+    // The barrier outlives this call if the loop stops before reaching it
+    auto const passed = std::make_shared<bool>(false);
+    enqueue(priority,
+        [this, passed]
         {
-            return p.first == timeout;
+            {
+                std::lock_guard<std::mutex> lock{drain_mutex};
+                *passed = true;
+            }
+            drained.notify_all();
         });
-    return (iter == end(timeouts) ? -1 : iter->second);
+
+    drained.wait(lock, [this, &passed] { return *passed || !in_run; });
 }
 
-void usc::DBusEventLoop::wake_up_loop()
+uint64_t usc::DBusEventLoop::coalesced_wake_ups() const
 {
-    if (write(wake_up_fd_w, "a", 1) != 1)
-    {
-        BOOST_THROW_EXCEPTION(
-            std::system_error(errno, std::system_category(), "write"));
-    }
+    return coalesced_wake_ups_.load(std::memory_order_relaxed);
+}
+
+usc::ActionQueue& usc::DBusEventLoop::actions_for(Priority priority)
+{
+    return priority == Priority::high ? high_priority_actions : normal_priority_actions;
 }
 
-void usc::DBusEventLoop::enqueue(std::function<void()> const& action)
+void usc::DBusEventLoop::dispatch_actions(Priority priority)
 {
+    if (actions_for(priority).dispatch())
+        wake_up_loop();
+}
+
+void usc::DBusEventLoop::dispatch_connections(Priority priority)
+{
+    for (auto const& connection : connections)
     {
-        std::lock_guard<std::mutex> lock{mutex};
-        actions.push_back(action);
+        if (connection->priority != priority)
+            continue;
+
+        if (connection->needs_dispatch.exchange(false))
+        {
+            auto const dispatch_one =
+                [&]
+                {
+                    HandlerTimer const timer{handler_run_time};
+                    return dbus_connection_dispatch(*connection->handle);
+                };
+
+            if (priority == Priority::high)
+            {
+                while (dispatch_one() == DBUS_DISPATCH_DATA_REMAINS);
+            }
+            else if (dispatch_one() == DBUS_DISPATCH_DATA_REMAINS)
+            {
+                // Handle normal priority messages one per iteration, so that
+                // high priority work arriving in the meantime doesn't have to
+                // wait behind a long backlog
+                connection->needs_dispatch = true;
+                wake_up_loop();
+            }
+        }
+
+        // Replies to the messages we just dispatched are sent here too
+        if (dbus_connection_has_messages_to_send(*connection->handle))
+            dbus_connection_flush(*connection->handle);
     }
+}
 
-    wake_up_loop();
+void usc::DBusEventLoop::record_action_latency(TimerQueue::Clock::time_point enqueued)
+{
+    action_latency.record(microseconds_since(enqueued));
 }
 
-void usc::DBusEventLoop::dispatch_actions()
+void usc::DBusEventLoop::check_for_stall(TimerQueue::Clock::time_point iteration_start)
 {
-    decltype(actions) actions_to_dispatch;
+    if (stall_threshold == std::chrono::milliseconds::zero())
+        return;
 
+    auto const duration = std::chrono::duration_cast<std::chrono::milliseconds>(
+        TimerQueue::Clock::now() - iteration_start);
+
+    if (duration > stall_threshold)
     {
-        std::lock_guard<std::mutex> lock{mutex};
-        actions.swap(actions_to_dispatch);
+        stalled_iterations.fetch_add(1, std::memory_order_relaxed);
+        mir::log(::mir::logging::Severity::warning, "usc::DBusEventLoop",
+                 "Loop iteration took %lld ms (threshold is %lld ms)",
+                 static_cast<long long>(duration.count()),
+                 static_cast<long long>(stall_threshold.count()));
+
+        // Stalls are rare, and the statistics show whether this one was
+        // a one-off or part of a trend
+        auto const stats = statistics();
+        log_histogram("action latency (us)", stats.action_latency);
+        log_histogram("handler run time (us)", stats.handler_run_time);
+        log_histogram("wake-ups per second", stats.wake_ups_per_second);
+        mir::log(::mir::logging::Severity::informational, "usc::DBusEventLoop",
+                 "  %llu stalled iterations, %llu coalesced wake-ups",
+                 static_cast<unsigned long long>(stats.stalled_iterations),
+                 static_cast<unsigned long long>(coalesced_wake_ups()));
     }
+}
 
-    for (auto const& action : actions_to_dispatch)
-        action();
+usc::DBusEventLoop::Statistics usc::DBusEventLoop::statistics() const
+{
+    return Statistics{
+        action_latency.snapshot(),
+        handler_run_time.snapshot(),
+        wake_ups_per_second.snapshot(),
+        stalled_iterations.load(std::memory_order_relaxed)};
+}
+
+usc::DBusEventLoop::HandlerTimer::HandlerTimer(Histogram& run_time)
+    : run_time(run_time),
+      start{TimerQueue::Clock::now()}
+{
+}
+
+usc::DBusEventLoop::HandlerTimer::~HandlerTimer()
+{
+    run_time.record(microseconds_since(start));
 }
 
 dbus_bool_t usc::DBusEventLoop::static_add_watch(DBusWatch* watch, void* data)
 {
-    return static_cast<DBusEventLoop*>(data)->add_watch(watch);
+    auto const connection = static_cast<Connection*>(data);
+    return connection->loop->add_watch(watch, connection->priority);
 }
 
 void usc::DBusEventLoop::static_remove_watch(DBusWatch* watch, void* data)
 {
-    static_cast<DBusEventLoop*>(data)->remove_watch(watch);
+    static_cast<Connection*>(data)->loop->remove_watch(watch);
 }
 
 void usc::DBusEventLoop::static_toggle_watch(DBusWatch* watch, void* data)
 {
-    static_cast<DBusEventLoop*>(data)->toggle_watch(watch);
+    static_cast<Connection*>(data)->loop->toggle_watch(watch);
+}
+
+dbus_bool_t usc::DBusEventLoop::static_add_server_watch(DBusWatch* watch, void* data)
+{
+    auto const server = static_cast<Server*>(data);
+    return server->loop->add_watch(watch, server->priority);
+}
+
+void usc::DBusEventLoop::static_remove_server_watch(DBusWatch* watch, void* data)
+{
+    static_cast<Server*>(data)->loop->remove_watch(watch);
+}
+
+void usc::DBusEventLoop::static_toggle_server_watch(DBusWatch* watch, void* data)
+{
+    static_cast<Server*>(data)->loop->toggle_watch(watch);
 }
 
 dbus_bool_t usc::DBusEventLoop::static_add_timeout(DBusTimeout* timeout, void* data)
@@ -456,3 +809,18 @@ void usc::DBusEventLoop::static_wake_up_loop(void* data)
 {
     static_cast<DBusEventLoop*>(data)->wake_up_loop();
 }
+
+void usc::DBusEventLoop::static_dispatch_status_changed(
+    DBusConnection*, DBusDispatchStatus new_status, void* data)
+{
+    if (new_status != DBUS_DISPATCH_DATA_REMAINS)
+        return;
+
+    // This is called with the connection lock held, so we can only note
+    // the change here and leave the dispatching to the loop
+    auto const connection = static_cast<Connection*>(data);
+    connection->needs_dispatch = true;
+
+    if (std::this_thread::get_id() != connection->loop->loop_thread)
+        connection->loop->wake_up_loop();
+}
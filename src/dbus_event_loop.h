@@ -19,14 +19,23 @@
 #ifndef USC_DBUS_EVENT_LOOP_H_
 #define USC_DBUS_EVENT_LOOP_H_
 
+#include "action_queue.h"
+#include "histogram.h"
+#include "timer_queue.h"
+
 #include <mir/fd.h>
 
 #include <dbus/dbus.h>
 
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <vector>
+#include <unordered_map>
 #include <mutex>
 #include <future>
+#include <thread>
+#include <memory>
 
 namespace usc
 {
@@ -35,20 +44,174 @@ class DBusConnectionHandle;
 class DBusEventLoop
 {
 public:
-    DBusEventLoop();
+    // Work of high priority (e.g. display power changes) is always handled
+    // before work of normal priority that is pending in the same iteration
+    enum class Priority { high, normal };
+
+    static std::chrono::milliseconds const default_stall_threshold;
+
+    // Iterations that take longer than stall_threshold are logged as
+    // warnings. A zero threshold disables the check.
+    explicit DBusEventLoop(
+        std::chrono::milliseconds stall_threshold = default_stall_threshold);
     ~DBusEventLoop();
 
-    void add_connection(std::shared_ptr<DBusConnectionHandle> const& connection);
+    // Adding a connection that is already in the loop only counts another
+    // user of it, so services sharing a connection can each add it. Its
+    // messages can't be told apart before they are dispatched, so the
+    // connection is raised to high priority if any of its users asks for
+    // that, whatever order they add it in, and stays so. It stays in the
+    // loop until each user has removed it.
+    //
+    // Connections may only be added before the loop starts or on the loop
+    // thread, outside of the dispatching of any connection (e.g. from an
+    // enqueued action). Removals from other threads while the loop is
+    // running are deferred to the loop thread.
+    void add_connection(
+        std::shared_ptr<DBusConnectionHandle> const& connection,
+        Priority priority = Priority::normal);
+    void remove_connection(std::shared_ptr<DBusConnectionHandle> const& connection);
+    // Only valid where connections may be added. Throws if the connection
+    // isn't in the loop.
+    Priority priority_of(std::shared_ptr<DBusConnectionHandle> const& connection);
+
+    // Accepts incoming peer-to-peer connections for a server on the loop
+    // thread. Servers can only be added before the loop starts, and be
+    // removed when the loop isn't running.
+    void add_server(DBusServer* server, Priority priority = Priority::normal);
+    void remove_server(DBusServer* server);
     void run(std::promise<void>& started);
     void stop();
 
-    void enqueue(std::function<void()> const& action);
+    // Actions are stored inline in a preallocated queue, see usc::Task
+    // for the size limit on their captured state. The loop's own
+    // bookkeeping takes 16 bytes of that.
+    template <typename Action>
+    void enqueue(Action&& action)
+    {
+        enqueue(Priority::normal, std::forward<Action>(action));
+    }
+
+    template <typename Action>
+    void enqueue(Priority priority, Action&& action)
+    {
+        // Only the first action in a batch needs to wake up the loop, since
+        // dispatch_actions() drains everything queued up to that point
+        if (actions_for(priority).push(instrumented(std::forward<Action>(action))))
+            wake_up_loop();
+    }
+
+    using DelayedActionId = TimerQueue::TimerId;
+
+    // Runs the action on the loop thread once the deadline has passed.
+    // The returned id can be used to cancel the action until it starts.
+    template <typename Action>
+    DelayedActionId enqueue_at(TimerQueue::Clock::time_point deadline, Action&& action)
+    {
+        return timer_queue.schedule(
+            deadline,
+            [this, action = std::forward<Action>(action)] () mutable
+            {
+                HandlerTimer const timer{handler_run_time};
+                action();
+            });
+    }
+
+    template <typename Rep, typename Period, typename Action>
+    DelayedActionId enqueue_after(std::chrono::duration<Rep,Period> delay, Action&& action)
+    {
+        return enqueue_at(TimerQueue::Clock::now() + delay, std::forward<Action>(action));
+    }
+
+    // Returns false if the action has already started or been cancelled
+    bool cancel(DelayedActionId id);
+
+    // Waits until the loop has run the actions enqueued with the given
+    // priority so far, and finished whatever it was doing when called.
+    // Lets owners of queued actions make sure none of them is still
+    // running before tearing down what they use. Returns straight away
+    // on the loop thread or if the loop isn't running, and once the loop
+    // leaves run() if it is stopped in the meantime.
+    void drain(Priority priority);
+
+    // Number of wake-up requests that were folded into an earlier,
+    // still pending wake-up of the loop
+    uint64_t coalesced_wake_ups() const;
+
+    struct Statistics
+    {
+        // Time from enqueue() to the action starting, in microseconds
+        Histogram::Snapshot action_latency;
+        // Run time of actions and DBus message handlers, in microseconds
+        Histogram::Snapshot handler_run_time;
+        // Loop wake-ups over each one second window with any activity
+        Histogram::Snapshot wake_ups_per_second;
+        // Iterations that exceeded the stall threshold
+        uint64_t stalled_iterations;
+    };
+
+    // May be called from any thread
+    Statistics statistics() const;
 
 private:
-    std::vector<DBusWatch*> enabled_watches_for(int fd);
-    DBusTimeout* enabled_timeout_for(int fd);
+    class HandlerTimer
+    {
+    public:
+        explicit HandlerTimer(Histogram& run_time);
+        ~HandlerTimer();
+
+    private:
+        Histogram& run_time;
+        TimerQueue::Clock::time_point const start;
+    };
+
+    template <typename Action>
+    Task instrumented(Action&& action)
+    {
+        return Task{
+            [this,
+             enqueued = TimerQueue::Clock::now(),
+             action = std::forward<Action>(action)] () mutable
+            {
+                record_action_latency(enqueued);
+                HandlerTimer const timer{handler_run_time};
+                action();
+            }};
+    }
+
+    struct Connection
+    {
+        DBusEventLoop* const loop;
+        std::shared_ptr<DBusConnectionHandle> const handle;
+        // Only changed on the loop thread
+        Priority priority;
+        int users;
+        // Assume messages may have arrived before we started tracking
+        std::atomic<bool> needs_dispatch{true};
+    };
+
+    struct Server
+    {
+        DBusEventLoop* const loop;
+        DBusServer* const server;
+        Priority const priority;
+    };
+
+    struct WatchedFd
+    {
+        std::vector<DBusWatch*> watches;
+        Priority priority;
+    };
+
+    void ensure_connections_can_change();
+    void raise_priority(Connection& connection);
+    void stop_watching(DBusConnection* connection);
+    void stop_watching(DBusServer* server);
+    void handle_event(int fd, uint32_t events);
+    bool is_high_priority_fd(int fd);
+    void enabled_watches_for(int fd, std::vector<DBusWatch*>& enabled_watches);
 
-    dbus_bool_t add_watch(DBusWatch* watch);
+    dbus_bool_t add_watch(DBusWatch* watch, Priority priority);
     void remove_watch(DBusWatch* watch);
     void toggle_watch(DBusWatch* watch);
     void update_events_for_watch_fd(int watch_fd);
@@ -58,30 +221,54 @@ private:
     dbus_bool_t add_timeout(DBusTimeout* timeout);
     void remove_timeout(DBusTimeout* timeout);
     void toggle_timeout(DBusTimeout* timeout);
-    dbus_bool_t update_timer_fd_for(DBusTimeout* timeout);
-    int timer_fd_for(DBusTimeout* timeout);
+    void schedule_timeout(DBusTimeout* timeout);
+    void handle_timeout(DBusTimeout* timeout);
 
     void wake_up_loop();
-    void dispatch_actions();
+    ActionQueue& actions_for(Priority priority);
+    void dispatch_actions(Priority priority);
+    void dispatch_connections(Priority priority);
+    void record_action_latency(TimerQueue::Clock::time_point enqueued);
+    void check_for_stall(TimerQueue::Clock::time_point iteration_start);
 
     static dbus_bool_t static_add_watch(DBusWatch* watch, void* data);
     static void static_remove_watch(DBusWatch* watch, void* data);
     static void static_toggle_watch(DBusWatch* watch, void* data);
+    static dbus_bool_t static_add_server_watch(DBusWatch* watch, void* data);
+    static void static_remove_server_watch(DBusWatch* watch, void* data);
+    static void static_toggle_server_watch(DBusWatch* watch, void* data);
     static dbus_bool_t static_add_timeout(DBusTimeout* timeout, void* data);
     static void static_remove_timeout(DBusTimeout* timeout, void* data);
     static void static_toggle_timeout(DBusTimeout* timeout, void* data);
     static void static_wake_up_loop(void* data);
+    static void static_dispatch_status_changed(
+        DBusConnection* connection, DBusDispatchStatus new_status, void* data);
 
     std::atomic<bool> running;
+    std::atomic<std::thread::id> loop_thread;
+    // Whether the loop thread is inside run(), which it may still be for
+    // a while after stop()
+    std::mutex drain_mutex;
+    std::condition_variable drained;
+    bool in_run;
+    std::atomic<uint64_t> coalesced_wake_ups_;
+    std::chrono::milliseconds const stall_threshold;
+    std::atomic<uint64_t> stalled_iterations;
+    Histogram action_latency;
+    Histogram handler_run_time;
+    Histogram wake_ups_per_second;
 
     std::mutex mutex;
-    std::vector<std::shared_ptr<DBusConnectionHandle>> connections;
-    std::vector<DBusWatch*> watches;
-    std::vector<std::pair<DBusTimeout*,mir::Fd>> timeouts;
-    std::vector<std::function<void(void)>> actions;
+    std::vector<std::unique_ptr<Connection>> connections;
+    std::vector<std::unique_ptr<Server>> servers;
+    std::unordered_map<int,WatchedFd> watches;
+    std::unordered_map<DBusTimeout*,TimerQueue::TimerId> timeouts;
+    ActionQueue high_priority_actions;
+    ActionQueue normal_priority_actions;
+    TimerQueue timer_queue;
     mir::Fd epoll_fd;
-    mir::Fd wake_up_fd_r;
-    mir::Fd wake_up_fd_w;
+    mir::Fd wake_up_fd;
+    std::vector<DBusWatch*> ready_watches;
 };
 
 }
@@ -0,0 +1,137 @@
+/*
+ * Copyright © 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "dbus_method_table.h"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <stdexcept>
+#include <boost/throw_exception.hpp>
+
+namespace
+{
+
+// FNV-1a over "interface\0member"
+std::size_t hash_of(char const* interface, char const* member)
+{
+    std::size_t hash = 2166136261u;
+
+    auto const mix =
+        [&hash] (char const* str)
+        {
+            do
+            {
+                hash ^= static_cast<unsigned char>(*str);
+                hash *= 16777619u;
+            }
+            while (*str++);
+        };
+
+    mix(interface);
+    mix(member);
+
+    return hash;
+}
+
+std::size_t const max_slots = 1 << 16;
+
+}
+
+usc::DBusMethodTable::DBusMethodTable(
+    DBusMethodDescription const* descriptions,
+    std::size_t num_descriptions,
+    std::initializer_list<Binding> bindings)
+{
+    for (auto const& binding : bindings)
+    {
+        auto const description = std::find_if(
+            descriptions, descriptions + num_descriptions,
+            [&binding] (DBusMethodDescription const& d)
+            {
+                return strcmp(d.interface, binding.interface) == 0 &&
+                       strcmp(d.member, binding.member) == 0;
+            });
+
+        if (description == descriptions + num_descriptions)
+        {
+            BOOST_THROW_EXCEPTION(
+                std::logic_error(
+                    std::string{"No description for method "} +
+                    binding.interface + "." + binding.member));
+        }
+
+        methods.push_back({*description, binding.handler, binding.rate_limited});
+    }
+
+    std::size_t num_slots{1};
+    while (num_slots < 2 * methods.size())
+        num_slots *= 2;
+
+    while (!try_build_slots(num_slots))
+    {
+        num_slots *= 2;
+        if (num_slots > max_slots)
+            BOOST_THROW_EXCEPTION(std::logic_error("Failed to build DBus method table"));
+    }
+}
+
+bool usc::DBusMethodTable::try_build_slots(std::size_t num_slots)
+{
+    slots.assign(num_slots, -1);
+
+    for (std::size_t i = 0; i < methods.size(); ++i)
+    {
+        auto const& description = methods[i].description;
+        auto& slot = slots[hash_of(description.interface, description.member) & (num_slots - 1)];
+
+        if (slot != -1)
+            return false;
+
+        slot = i;
+    }
+
+    return true;
+}
+
+usc::DBusMethodTable::Method const* usc::DBusMethodTable::find(DBusMessage* message) const
+{
+    if (dbus_message_get_type(message) != DBUS_MESSAGE_TYPE_METHOD_CALL)
+        return nullptr;
+
+    auto const interface = dbus_message_get_interface(message);
+    auto const member = dbus_message_get_member(message);
+    if (!interface || !member)
+        return nullptr;
+
+    auto const slot = slots[hash_of(interface, member) & (slots.size() - 1)];
+    if (slot == -1)
+        return nullptr;
+
+    auto const& method = methods[slot];
+    if (strcmp(method.description.interface, interface) != 0 ||
+        strcmp(method.description.member, member) != 0)
+    {
+        return nullptr;
+    }
+
+    return &method;
+}
+
+bool usc::DBusMethodTable::Method::accepts_arguments_of(DBusMessage* message) const
+{
+    return dbus_message_has_signature(message, description.signature);
+}
@@ -0,0 +1,95 @@
+/*
+ * Copyright © 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef USC_DBUS_METHOD_TABLE_H_
+#define USC_DBUS_METHOD_TABLE_H_
+
+#include <dbus/dbus.h>
+
+#include <cstddef>
+#include <functional>
+#include <initializer_list>
+#include <vector>
+
+namespace usc
+{
+
+// Generated from introspection XML by generate_method_table_from_introspection.sh
+struct DBusMethodDescription
+{
+    char const* interface;
+    char const* member;
+    char const* signature;
+};
+
+/*
+ * Routes method calls to handlers in constant time. The table is built
+ * once, with its size chosen so that every method hashes to a slot of its
+ * own, so a lookup costs one hash and one string comparison.
+ */
+class DBusMethodTable
+{
+public:
+    using Handler = std::function<void(DBusMessage*)>;
+
+    struct Binding
+    {
+        char const* interface;
+        char const* member;
+        Handler handler;
+        // Whether calls count against the caller's rate limit, decided
+        // once here rather than on every call
+        bool rate_limited{false};
+    };
+
+    struct Method
+    {
+        DBusMethodDescription description;
+        Handler handler;
+        bool rate_limited;
+
+        // Whether the message arguments match the introspected signature
+        bool accepts_arguments_of(DBusMessage* message) const;
+    };
+
+    // Methods that are described but not bound are treated as unknown.
+    // Binding a method that is not described is a programming error.
+    template <std::size_t N>
+    DBusMethodTable(
+        DBusMethodDescription const (&descriptions)[N],
+        std::initializer_list<Binding> bindings)
+        : DBusMethodTable{descriptions, N, bindings}
+    {
+    }
+
+    // Returns nullptr if the message is not a call to a bound method
+    Method const* find(DBusMessage* message) const;
+
+private:
+    DBusMethodTable(
+        DBusMethodDescription const* descriptions,
+        std::size_t num_descriptions,
+        std::initializer_list<Binding> bindings);
+
+    bool try_build_slots(std::size_t num_slots);
+
+    std::vector<Method> methods;
+    std::vector<int> slots;
+};
+
+}
+
+#endif
@@ -0,0 +1,150 @@
+/*
+ * Copyright © 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "dbus_peer_server.h"
+#include "dbus_connection_handle.h"
+#include "scoped_dbus_error.h"
+
+#include <mir/log.h>
+
+#include <algorithm>
+#include <stdexcept>
+#include <boost/throw_exception.hpp>
+
+usc::DBusPeerServer::DBusPeerServer(
+    std::shared_ptr<DBusEventLoop> const& loop,
+    std::string const& address,
+    DBusEventLoop::Priority priority,
+    PeerHandler const& on_connect,
+    PeerHandler const& on_disconnect)
+    : loop{loop},
+      priority{priority},
+      on_connect{on_connect},
+      on_disconnect{on_disconnect}
+{
+    dbus_threads_init_default();
+    ScopedDBusError error;
+
+    server = dbus_server_listen(address.c_str(), &error);
+    if (!server || error)
+    {
+        BOOST_THROW_EXCEPTION(
+            std::runtime_error("dbus_server_listen: " + error.message_str()));
+    }
+
+    // Peers are local, so there is no need for the cookie mechanism,
+    // which would look into our home directory
+    char const* mechanisms[] = {"EXTERNAL", nullptr};
+    dbus_server_set_auth_mechanisms(server, mechanisms);
+
+    dbus_server_set_new_connection_function(
+        server, DBusPeerServer::static_new_connection, this, nullptr);
+
+    try
+    {
+        loop->add_server(server, priority);
+    }
+    catch (...)
+    {
+        dbus_server_disconnect(server);
+        dbus_server_unref(server);
+        throw;
+    }
+}
+
+usc::DBusPeerServer::~DBusPeerServer()
+{
+    loop->remove_server(server);
+    dbus_server_disconnect(server);
+    dbus_server_unref(server);
+
+    for (auto const& peer : peers)
+    {
+        dbus_connection_remove_filter(*peer, DBusPeerServer::static_handle_local_message, this);
+        loop->remove_connection(peer);
+        on_disconnect(peer);
+    }
+}
+
+std::string usc::DBusPeerServer::address() const
+{
+    auto const server_address = dbus_server_get_address(server);
+    std::string const result{server_address};
+    dbus_free(server_address);
+    return result;
+}
+
+void usc::DBusPeerServer::add_peer(DBusConnection* connection)
+{
+    auto const peer = std::make_shared<DBusConnectionHandle>(connection);
+
+    dbus_connection_set_exit_on_disconnect(*peer, FALSE);
+    peer->add_filter(DBusPeerServer::static_handle_local_message, this);
+    loop->add_connection(peer, priority);
+    peers.push_back(peer);
+
+    on_connect(peer);
+}
+
+void usc::DBusPeerServer::remove_peer(DBusConnection* connection)
+{
+    auto const iter = std::find_if(begin(peers), end(peers),
+        [connection] (std::shared_ptr<DBusConnectionHandle> const& peer)
+        {
+            return *peer == connection;
+        });
+    if (iter == end(peers))
+        return;
+
+    auto const peer = *iter;
+    peers.erase(iter);
+
+    dbus_connection_remove_filter(*peer, DBusPeerServer::static_handle_local_message, this);
+    loop->remove_connection(peer);
+    on_disconnect(peer);
+}
+
+void usc::DBusPeerServer::static_new_connection(
+    DBusServer*, DBusConnection* connection, void* data)
+{
+    // We are called from libdbus, so don't let exceptions escape. A
+    // connection that we don't take a reference to is dropped.
+    try
+    {
+        static_cast<DBusPeerServer*>(data)->add_peer(connection);
+    }
+    catch (std::exception const& e)
+    {
+        mir::log(::mir::logging::Severity::warning, "usc::DBusPeerServer",
+                 "Failed to accept peer connection: %s", e.what());
+        dbus_connection_close(connection);
+    }
+}
+
+DBusHandlerResult usc::DBusPeerServer::static_handle_local_message(
+    DBusConnection* connection, DBusMessage* message, void* data)
+{
+    if (dbus_message_is_signal(message, DBUS_INTERFACE_LOCAL, "Disconnected"))
+    {
+        // We are in the middle of dispatching this connection, so leave
+        // removing it from the loop for later
+        auto const peer_server = static_cast<DBusPeerServer*>(data);
+        peer_server->loop->enqueue(
+            [peer_server, connection] { peer_server->remove_peer(connection); });
+    }
+
+    return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+}
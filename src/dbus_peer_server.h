@@ -0,0 +1,80 @@
+/*
+ * Copyright © 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef USC_DBUS_PEER_SERVER_H_
+#define USC_DBUS_PEER_SERVER_H_
+
+#include "dbus_event_loop.h"
+
+#include <dbus/dbus.h>
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace usc
+{
+class DBusConnectionHandle;
+
+// Lets trusted local clients talk to our services directly, instead of
+// through the bus daemon. Only clients running as the same user as us
+// are accepted.
+class DBusPeerServer
+{
+public:
+    using PeerHandler = std::function<void(std::shared_ptr<DBusConnectionHandle> const&)>;
+
+    // Listens on address, e.g. "unix:path=/run/usc-dbus". Accepted peers
+    // are added to the loop with the given priority and passed to
+    // on_connect, then passed to on_disconnect once they go away. Both
+    // handlers are called on the loop thread.
+    DBusPeerServer(
+        std::shared_ptr<DBusEventLoop> const& loop,
+        std::string const& address,
+        DBusEventLoop::Priority priority,
+        PeerHandler const& on_connect,
+        PeerHandler const& on_disconnect);
+    // Must be destroyed on the loop thread or while the loop isn't running
+    ~DBusPeerServer();
+
+    // The address clients connect to, which unlike the listening address
+    // names the actual socket for e.g. "unix:tmpdir=/tmp"
+    std::string address() const;
+
+private:
+    DBusPeerServer(DBusPeerServer const&) = delete;
+    DBusPeerServer& operator=(DBusPeerServer const&) = delete;
+
+    static void static_new_connection(
+        DBusServer* server, DBusConnection* connection, void* data);
+    static DBusHandlerResult static_handle_local_message(
+        DBusConnection* connection, DBusMessage* message, void* data);
+
+    void add_peer(DBusConnection* connection);
+    void remove_peer(DBusConnection* connection);
+
+    std::shared_ptr<DBusEventLoop> const loop;
+    DBusEventLoop::Priority const priority;
+    PeerHandler const on_connect;
+    PeerHandler const on_disconnect;
+    DBusServer* server;
+    std::vector<std::shared_ptr<DBusConnectionHandle>> peers;
+};
+
+}
+
+#endif
@@ -0,0 +1,80 @@
+/*
+ * Copyright © 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "dbus_reply_cache.h"
+
+namespace
+{
+
+usc::DBusMessageHandle fresh_reply(
+    DBusMessage* call, usc::DBusReplyCache::Marshaller const& marshaller)
+{
+    usc::DBusMessageHandle reply{dbus_message_new_method_return(call)};
+    if (reply)
+        marshaller(reply);
+    return reply;
+}
+
+}
+
+usc::DBusReplyCache::~DBusReplyCache()
+{
+    for (auto const reply : replies)
+    {
+        if (reply)
+            dbus_message_unref(reply);
+    }
+}
+
+usc::DBusMessageHandle usc::DBusReplyCache::reply_to(
+    DBusMessage* call, Key key, Marshaller const& marshaller)
+{
+    if (key >= replies.size())
+        replies.resize(key + 1, nullptr);
+
+    auto& cached = replies[key];
+
+    if (!cached)
+    {
+        cached = dbus_message_new(DBUS_MESSAGE_TYPE_METHOD_RETURN);
+        if (!cached)
+            return fresh_reply(call, marshaller);
+
+        // Like dbus_message_new_method_return(), a reply expects no reply
+        dbus_message_set_no_reply(cached, TRUE);
+        marshaller(cached);
+    }
+
+    // Copying takes the marshalled header and body as they are
+    DBusMessageHandle reply{dbus_message_copy(cached)};
+    if (!reply)
+        return fresh_reply(call, marshaller);
+
+    dbus_message_set_reply_serial(reply, dbus_message_get_serial(call));
+    if (auto const sender = dbus_message_get_sender(call))
+        dbus_message_set_destination(reply, sender);
+
+    return reply;
+}
+
+void usc::DBusReplyCache::invalidate(Key key)
+{
+    if (key < replies.size() && replies[key])
+    {
+        dbus_message_unref(replies[key]);
+        replies[key] = nullptr;
+    }
+}
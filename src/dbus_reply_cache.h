@@ -0,0 +1,66 @@
+/*
+ * Copyright © 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef USC_DBUS_REPLY_CACHE_H_
+#define USC_DBUS_REPLY_CACHE_H_
+
+#include "dbus_message_handle.h"
+
+#include <dbus/dbus.h>
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+namespace usc
+{
+
+// Keeps method replies whose body doesn't depend on the caller. The body
+// is marshalled once per key, and each reply is a copy of the already
+// marshalled message with only the reply serial and destination filled in.
+// Replies are keyed by small indices a service numbers its cacheable
+// replies with, so a lookup is an array access.
+//
+// Not thread safe, a service uses it from its DBus loop thread only.
+class DBusReplyCache
+{
+public:
+    using Marshaller = std::function<void(DBusMessage* reply)>;
+    using Key = std::size_t;
+
+    DBusReplyCache() = default;
+    ~DBusReplyCache();
+
+    // Calls marshaller to append the body if there is no reply cached
+    // for key, then returns a reply to call carrying that body. Doesn't
+    // throw as it's used from DBus handlers: if the cached reply can't be
+    // made or copied, the reply is built from scratch instead.
+    DBusMessageHandle reply_to(DBusMessage* call, Key key, Marshaller const& marshaller);
+
+    // Drops the cached reply, e.g. after the value it carries changed
+    void invalidate(Key key);
+
+private:
+    DBusReplyCache(DBusReplyCache const&) = delete;
+    DBusReplyCache& operator=(DBusReplyCache const&) = delete;
+
+    // Indexed by key, null where nothing is cached
+    std::vector<DBusMessage*> replies;
+};
+
+}
+
+#endif
@@ -0,0 +1,52 @@
+# Copyright © 2017 Canonical Ltd.
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License version 3 as
+# published by the Free Software Foundation.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+# Generates an array of usc::DBusMethodDescription, holding the interface,
+# member and input signature of every method in an introspection XML file.
+# Expects one element per line, as in our introspection files.
+
+header=$1
+varname=$2
+filename=$3
+
+header_guard=$(echo "USC_$(basename $header)_" | tr '[a-z].' '[A-Z]_')
+
+methods=$(awk '
+function attr(line, name)
+{
+    if (match(line, name "=[\"\047][^\"\047]*[\"\047]"))
+        return substr(line, RSTART + length(name) + 2, RLENGTH - length(name) - 3)
+    return ""
+}
+
+function emit()
+{
+    printf "    {\"%s\", \"%s\", \"%s\"},\n", interface, method, signature
+    in_method = 0
+}
+
+/<interface / { interface = attr($0, "name") }
+/<method / { method = attr($0, "name"); signature = ""; in_method = 1 }
+/<method .*\/>/ { emit() }
+/<arg / && in_method && attr($0, "direction") != "out" { signature = signature attr($0, "type") }
+/<\/method>/ { emit() }
+' $filename)
+
+echo "#ifndef $header_guard
+#define $header_guard
+#include \"dbus_method_table.h\"
+usc::DBusMethodDescription const $varname[] = {
+$methods
+};
+#endif" > $header
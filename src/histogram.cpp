@@ -0,0 +1,95 @@
+/*
+ * Copyright © 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "histogram.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+
+std::size_t bucket_for(uint64_t value)
+{
+    if (value == 0)
+        return 0;
+
+    std::size_t const bucket = 64 - __builtin_clzll(value);
+    return std::min(bucket, usc::Histogram::num_buckets - 1);
+}
+
+}
+
+usc::Histogram::Histogram()
+    : sum{0},
+      max{0}
+{
+    for (auto& count : counts)
+        count = 0;
+}
+
+void usc::Histogram::record(uint64_t value)
+{
+    counts[bucket_for(value)].fetch_add(1, std::memory_order_relaxed);
+    sum.fetch_add(value, std::memory_order_relaxed);
+
+    if (value > max.load(std::memory_order_relaxed))
+        max.store(value, std::memory_order_relaxed);
+}
+
+usc::Histogram::Snapshot usc::Histogram::snapshot() const
+{
+    Snapshot snapshot{};
+
+    for (std::size_t i = 0; i < num_buckets; ++i)
+    {
+        snapshot.counts[i] = counts[i].load(std::memory_order_relaxed);
+        snapshot.samples += snapshot.counts[i];
+    }
+
+    snapshot.sum = sum.load(std::memory_order_relaxed);
+    snapshot.max = max.load(std::memory_order_relaxed);
+
+    return snapshot;
+}
+
+uint64_t usc::Histogram::bucket_upper_bound(std::size_t bucket)
+{
+    if (bucket == 0)
+        return 0;
+
+    if (bucket >= num_buckets - 1)
+        return UINT64_MAX;
+
+    return (uint64_t{1} << bucket) - 1;
+}
+
+uint64_t usc::Histogram::Snapshot::percentile(double fraction) const
+{
+    // Nearest rank, so that the top percentiles of few samples aren't
+    // rounded down to a lower bucket
+    auto const wanted = static_cast<uint64_t>(std::ceil(fraction * samples));
+    uint64_t seen{0};
+
+    for (std::size_t i = 0; i < num_buckets; ++i)
+    {
+        seen += counts[i];
+        if (seen > 0 && seen >= wanted)
+            return std::min(bucket_upper_bound(i), max);
+    }
+
+    return max;
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright © 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef USC_HISTOGRAM_H_
+#define USC_HISTOGRAM_H_
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace usc
+{
+
+/*
+ * Counts samples in power of two buckets: bucket 0 holds zero, and bucket
+ * i > 0 holds values in [2^(i-1), 2^i). The last bucket also takes any
+ * larger values.
+ *
+ * Intended for a single recording thread; snapshot() may be called from
+ * any thread, but is not guaranteed to be consistent across buckets.
+ */
+class Histogram
+{
+public:
+    static std::size_t const num_buckets = 32;
+
+    struct Snapshot
+    {
+        std::array<uint64_t, num_buckets> counts;
+        uint64_t samples;
+        uint64_t sum;
+        uint64_t max;
+
+        // Upper bound of the bucket containing the given fraction of samples
+        uint64_t percentile(double fraction) const;
+    };
+
+    Histogram();
+
+    void record(uint64_t value);
+    Snapshot snapshot() const;
+
+    static uint64_t bucket_upper_bound(std::size_t bucket);
+
+private:
+    std::array<std::atomic<uint64_t>, num_buckets> counts;
+    std::atomic<uint64_t> sum;
+    std::atomic<uint64_t> max;
+};
+
+}
+
+#endif
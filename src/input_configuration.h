@@ -21,6 +21,35 @@
 
 namespace usc
 {
+// Values have the same meaning as the arguments of the matching setters
+struct InputSettings
+{
+    int32_t mouse_primary_button;
+    double mouse_cursor_speed;
+    double mouse_scroll_speed;
+    int32_t touchpad_primary_button;
+    double touchpad_cursor_speed;
+    double touchpad_scroll_speed;
+    bool two_finger_scroll;
+    bool tap_to_click;
+    bool disable_touchpad_while_typing;
+    bool disable_touchpad_with_mouse;
+};
+
+inline bool operator==(InputSettings const& a, InputSettings const& b)
+{
+    return a.mouse_primary_button == b.mouse_primary_button &&
+           a.mouse_cursor_speed == b.mouse_cursor_speed &&
+           a.mouse_scroll_speed == b.mouse_scroll_speed &&
+           a.touchpad_primary_button == b.touchpad_primary_button &&
+           a.touchpad_cursor_speed == b.touchpad_cursor_speed &&
+           a.touchpad_scroll_speed == b.touchpad_scroll_speed &&
+           a.two_finger_scroll == b.two_finger_scroll &&
+           a.tap_to_click == b.tap_to_click &&
+           a.disable_touchpad_while_typing == b.disable_touchpad_while_typing &&
+           a.disable_touchpad_with_mouse == b.disable_touchpad_with_mouse;
+}
+
 class InputConfiguration
 {
 public:
@@ -37,6 +66,10 @@ public:
     virtual void set_disable_touchpad_while_typing(bool enable) = 0;
     virtual void set_disable_touchpad_with_mouse(bool enable) = 0;
 
+    virtual InputSettings settings() = 0;
+    // Applies all settings with a single pass over the input devices
+    virtual void apply_settings(InputSettings const& settings) = 0;
+
 protected:
     InputConfiguration() = default;
     InputConfiguration(InputConfiguration const&) = delete;
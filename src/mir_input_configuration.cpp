@@ -49,6 +49,26 @@ struct DeviceObserver : mi::InputDeviceObserver
     {
     }
 };
+
+MirPointerHandedness handedness_for(int32_t button)
+{
+    return button == 0 ? mir_pointer_handedness_right : mir_pointer_handedness_left;
+}
+
+double acceleration_bias_for(double speed)
+{
+    double clamped = speed;
+    if (clamped < 0.0)
+        clamped = 0.0;
+    if (clamped > 1.0)
+        clamped = 1.0;
+    return clamped * 2.0 - 1.0;
+}
+
+double speed_for(double acceleration_bias)
+{
+    return (acceleration_bias + 1.0) / 2.0;
+}
 }
 
 
@@ -104,22 +124,25 @@ void usc::MirInputConfiguration::update_mice()
         configure_mouse(*mouse);
 }
 
+void usc::MirInputConfiguration::set_two_finger_scroll_mode(bool enable)
+{
+    MirTouchpadScrollModes current = touchpad_config.scroll_mode();
+    if (enable)
+        current |= mir_touchpad_scroll_mode_two_finger_scroll;
+    else
+        current &= ~mir_touchpad_scroll_mode_two_finger_scroll;
+    touchpad_config.scroll_mode(current);
+}
+
 void usc::MirInputConfiguration::set_mouse_primary_button(int32_t button)
 {
-    mouse_pointer_config.handedness(button == 0 ?
-        mir_pointer_handedness_right :
-        mir_pointer_handedness_left);
+    mouse_pointer_config.handedness(handedness_for(button));
     update_mice();
 }
 
 void usc::MirInputConfiguration::set_mouse_cursor_speed(double speed)
 {
-    double clamped = speed;
-    if (clamped < 0.0)
-        clamped = 0.0;
-    if (clamped > 1.0)
-        clamped = 1.0;
-    mouse_pointer_config.cursor_acceleration_bias(clamped * 2.0 - 1.0);
+    mouse_pointer_config.cursor_acceleration_bias(acceleration_bias_for(speed));
     update_mice();
 }
 
@@ -132,20 +155,13 @@ void usc::MirInputConfiguration::set_mouse_scroll_speed(double speed)
 
 void usc::MirInputConfiguration::set_touchpad_primary_button(int32_t button)
 {
-    touchpad_pointer_config.handedness(button == 0 ?
-        mir_pointer_handedness_right :
-        mir_pointer_handedness_left);
+    touchpad_pointer_config.handedness(handedness_for(button));
     update_touchpads();
 }
 
 void usc::MirInputConfiguration::set_touchpad_cursor_speed(double speed)
 {
-    double clamped = speed;
-    if (clamped < 0.0)
-        clamped = 0.0;
-    if (clamped > 1.0)
-        clamped = 1.0;
-    touchpad_pointer_config.cursor_acceleration_bias(clamped * 2.0 - 1.0);
+    touchpad_pointer_config.cursor_acceleration_bias(acceleration_bias_for(speed));
     update_touchpads();
 }
 
@@ -158,12 +174,7 @@ void usc::MirInputConfiguration::set_touchpad_scroll_speed(double speed)
 
 void usc::MirInputConfiguration::set_two_finger_scroll(bool enable)
 {
-    MirTouchpadScrollModes current = touchpad_config.scroll_mode();
-    if (enable)
-        current |= mir_touchpad_scroll_mode_two_finger_scroll;
-    else
-        current &= ~mir_touchpad_scroll_mode_two_finger_scroll;
-    touchpad_config.scroll_mode(current);
+    set_two_finger_scroll_mode(enable);
     update_touchpads();
 }
 
@@ -185,3 +196,42 @@ void usc::MirInputConfiguration::set_disable_touchpad_with_mouse(bool enable)
     update_touchpads();
 }
 
+usc::InputSettings usc::MirInputConfiguration::settings()
+{
+    std::lock_guard<decltype(devices_lock)> lock(devices_lock);
+
+    return InputSettings{
+        mouse_pointer_config.handedness() == mir_pointer_handedness_right ? 0 : 1,
+        speed_for(mouse_pointer_config.cursor_acceleration_bias()),
+        mouse_pointer_config.vertical_scroll_scale(),
+        touchpad_pointer_config.handedness() == mir_pointer_handedness_right ? 0 : 1,
+        speed_for(touchpad_pointer_config.cursor_acceleration_bias()),
+        touchpad_pointer_config.vertical_scroll_scale(),
+        (touchpad_config.scroll_mode() & mir_touchpad_scroll_mode_two_finger_scroll) != 0,
+        touchpad_config.tap_to_click(),
+        touchpad_config.disable_while_typing(),
+        touchpad_config.disable_with_mouse()};
+}
+
+void usc::MirInputConfiguration::apply_settings(InputSettings const& settings)
+{
+    std::lock_guard<decltype(devices_lock)> lock(devices_lock);
+
+    mouse_pointer_config.handedness(handedness_for(settings.mouse_primary_button));
+    mouse_pointer_config.cursor_acceleration_bias(acceleration_bias_for(settings.mouse_cursor_speed));
+    mouse_pointer_config.horizontal_scroll_scale(settings.mouse_scroll_speed);
+    mouse_pointer_config.vertical_scroll_scale(settings.mouse_scroll_speed);
+
+    touchpad_pointer_config.handedness(handedness_for(settings.touchpad_primary_button));
+    touchpad_pointer_config.cursor_acceleration_bias(acceleration_bias_for(settings.touchpad_cursor_speed));
+    touchpad_pointer_config.horizontal_scroll_scale(settings.touchpad_scroll_speed);
+    touchpad_pointer_config.vertical_scroll_scale(settings.touchpad_scroll_speed);
+
+    set_two_finger_scroll_mode(settings.two_finger_scroll);
+    touchpad_config.tap_to_click(settings.tap_to_click);
+    touchpad_config.disable_while_typing(settings.disable_touchpad_while_typing);
+    touchpad_config.disable_with_mouse(settings.disable_touchpad_with_mouse);
+
+    update_mice();
+    update_touchpads();
+}
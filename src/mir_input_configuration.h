@@ -54,6 +54,8 @@ public:
     void set_tap_to_click(bool enable) override;
     void set_disable_touchpad_while_typing(bool enable) override;
     void set_disable_touchpad_with_mouse(bool enable) override;
+    InputSettings settings() override;
+    void apply_settings(InputSettings const& settings) override;
 
     void device_added(std::shared_ptr<mir::input::Device> const& device);
     void device_removed(std::shared_ptr<mir::input::Device> const& device);
@@ -62,6 +64,7 @@ private:
     void configure_touchpad(mir::input::Device& dev);
     void update_touchpads();
     void update_mice();
+    void set_two_finger_scroll_mode(bool enable);
 
     std::shared_ptr<mir::input::InputDeviceObserver> const observer;
     std::mutex devices_lock;
@@ -15,6 +15,7 @@
  */
 
 #include "mir_screen.h"
+#include "tracer.h"
 
 #include <mir/compositor/compositor.h>
 #include <mir/graphics/display.h>
@@ -22,6 +23,7 @@
 #include <mir/log.h>
 #include <mir/report_exception.h>
 
+#include <algorithm>
 #include <cstdio>
 #include <sstream>
 
@@ -61,48 +63,93 @@ bool is_external(mir::graphics::DisplayConfigurationOutputType type)
            type == DisplayConfigurationOutputType::tv;
 }
 
-usc::ActiveOutputs count_active_outputs(
-    mir::graphics::DisplayConfiguration const& display_configuration)
+usc::ActiveOutputs count_active_outputs(usc::Outputs const& outputs)
 {
     usc::ActiveOutputs active_outputs{};
 
+    for (auto const& output : outputs)
+    {
+        if (output.active())
+        {
+            if (output.type == usc::OutputType::external)
+                ++active_outputs.external;
+            else
+                ++active_outputs.internal;
+        }
+    }
+
+    return active_outputs;
+}
+
+bool has_active_outputs(
+    mir::graphics::DisplayConfiguration const& display_configuration)
+{
+    bool result{false};
+
     display_configuration.for_each_output(
-        [&active_outputs](mir::graphics::DisplayConfigurationOutput const& output)
+        [&result](mir::graphics::DisplayConfigurationOutput const& output)
         {
             if (output.connected &&
                 output.used &&
                 output.power_mode == MirPowerMode::mir_power_mode_on)
             {
-                if (is_external(output.type))
-                    ++active_outputs.external;
-                else
-                    ++active_outputs.internal;
+                result = true;
             }
         });
 
-    return active_outputs;
+    return result;
 }
 
-bool has_active_outputs(
-    mir::graphics::DisplayConfiguration const& display_configuration)
+// Known outputs keep the type worked out when they first appeared
+usc::Outputs updated_outputs(
+    usc::Outputs const& known_outputs,
+    mg::DisplayConfiguration const& display_configuration)
 {
-    auto const active_outputs = count_active_outputs(display_configuration);
-    return active_outputs.internal + active_outputs.external > 0;
+    usc::Outputs outputs;
+
+    display_configuration.for_each_output(
+        [&](mg::DisplayConfigurationOutput const& config_output)
+        {
+            auto const id = config_output.id.as_value();
+
+            // Outputs are kept ordered by id, so known ones are found
+            // without scanning
+            auto const known = std::lower_bound(
+                known_outputs.begin(), known_outputs.end(), id,
+                [] (usc::Output const& output, usc::OutputId id) { return output.id < id; });
+
+            auto const type = known != known_outputs.end() && known->id == id ?
+                known->type :
+                is_external(config_output.type) ? usc::OutputType::external : usc::OutputType::internal;
+
+            outputs.push_back(
+                usc::Output{
+                    id,
+                    type,
+                    config_output.connected,
+                    config_output.used,
+                    config_output.power_mode == MirPowerMode::mir_power_mode_on});
+        });
+
+    std::sort(outputs.begin(), outputs.end(),
+        [] (usc::Output const& a, usc::Output const& b) { return a.id < b.id; });
+
+    return outputs;
 }
 
-bool all_outputs_filter(mir::graphics::UserDisplayConfigurationOutput const&)
+bool all_outputs_filter(usc::Output const&)
 {
     return true;
 }
 
-bool internal_outputs_filter(mir::graphics::UserDisplayConfigurationOutput const& output)
+bool internal_outputs_filter(usc::Output const& output)
 {
-    return !is_external(output.type);
+    return output.type == usc::OutputType::internal;
 }
 
-bool external_outputs_filter(mir::graphics::UserDisplayConfigurationOutput const& output)
+bool external_outputs_filter(usc::Output const& output)
 {
-    return is_external(output.type);
+    return output.type == usc::OutputType::external;
 }
 
 auto get_power_mode_filter_for_output_filter(usc::OutputFilter output_filter)
@@ -122,13 +169,24 @@ auto get_power_mode_filter_for_output_filter(usc::OutputFilter output_filter)
 
 usc::MirScreen::MirScreen(
     std::shared_ptr<mir::compositor::Compositor> const& compositor,
-    std::shared_ptr<mir::graphics::Display> const& display)
+    std::shared_ptr<mir::graphics::Display> const& display,
+    std::shared_ptr<Tracer> const& tracer)
     : compositor{compositor},
       display{display},
-      active_outputs_handler{[](ActiveOutputs const&){}}
+      tracer{tracer},
+      active_outputs_subscription{std::make_shared<Subscription>(
+          [](OutputsState const&){}, &OutputsState::generation)},
+      outputs_subscription{std::make_shared<Subscription>(
+          [](OutputsState const&){}, &OutputsState::outputs_generation)}
 {
     try
     {
+        // Power changes requested before the initial configuration
+        // arrives still need to know the outputs
+        configuration = display->configuration();
+        outputs_state = std::make_shared<OutputsState const>(
+            OutputsState{0, 0, updated_outputs({}, *configuration), {}});
+
         /*
          * Make sure the compositor is running as certain conditions can
          * cause Mir to tear down the compositor threads before we get
@@ -160,29 +218,75 @@ void usc::MirScreen::turn_off(OutputFilter output_filter)
 void usc::MirScreen::register_active_outputs_handler(
     ActiveOutputsHandler const& handler)
 {
-    // It's not ideal to call the handler under lock, but we need this to
-    // guarantee that after this function returns no invocation of the old
-    // handler will be in progress. Alternatively, we would need to implement
-    // an event loop.
-    std::lock_guard<std::mutex> lock{active_outputs_mutex};
-    active_outputs_handler = handler;
-    active_outputs_handler(active_outputs);
+    subscribe(
+        active_outputs_subscription,
+        std::make_shared<Subscription>(
+            [handler] (OutputsState const& state) { handler(state.active_outputs); },
+            &OutputsState::generation));
+}
+
+void usc::MirScreen::turn_on_output(OutputId id)
+{
+    set_power_mode(
+        MirPowerMode::mir_power_mode_on,
+        [id] (Output const& output) { return output.id == id; });
+}
+
+void usc::MirScreen::turn_off_output(OutputId id)
+{
+    set_power_mode(
+        MirPowerMode::mir_power_mode_off,
+        [id] (Output const& output) { return output.id == id; });
+}
+
+void usc::MirScreen::register_outputs_handler(
+    OutputsHandler const& handler)
+{
+    subscribe(
+        outputs_subscription,
+        std::make_shared<Subscription>(
+            [handler] (OutputsState const& state) { handler(state.outputs); },
+            &OutputsState::outputs_generation));
 }
 
 void usc::MirScreen::initial_configuration(
     std::shared_ptr<mir::graphics::DisplayConfiguration const> const& display_configuration)
 {
-    std::lock_guard<std::mutex> lock{active_outputs_mutex};
-    active_outputs = count_active_outputs(*display_configuration);
-    active_outputs_handler(active_outputs);
+    configuration_applied(display_configuration);
 }
 
 void usc::MirScreen::configuration_applied(
     std::shared_ptr<mir::graphics::DisplayConfiguration const> const& display_configuration)
 {
-    std::lock_guard<std::mutex> lock{active_outputs_mutex};
-    active_outputs = count_active_outputs(*display_configuration);
-    active_outputs_handler(active_outputs);
+    {
+        // Someone else may have changed the power modes behind our back
+        std::lock_guard<std::mutex> lock{power_mutex};
+        configuration = display_configuration;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock{outputs_update_mutex};
+
+        auto const previous = std::atomic_load(&outputs_state);
+        auto outputs = updated_outputs(previous->outputs, *display_configuration);
+        auto const outputs_generation = outputs == previous->outputs ?
+            previous->outputs_generation : previous->outputs_generation + 1;
+        auto const active_outputs = count_active_outputs(outputs);
+
+        std::atomic_store(
+            &outputs_state,
+            std::make_shared<OutputsState const>(
+                OutputsState{
+                    previous->generation + 1,
+                    outputs_generation,
+                    std::move(outputs),
+                    active_outputs}));
+    }
+
+    // Each handler is passed the latest state, which may already be newer
+    // than the one published above
+    notify(active_outputs_subscription);
+    notify(outputs_subscription);
 }
 
 void usc::MirScreen::base_configuration_updated(
@@ -213,30 +317,162 @@ void usc::MirScreen::catastrophic_configuration_error(
 {
 }
 
+usc::MirScreen::Subscription::Subscription(
+    std::function<void(OutputsState const&)> const& notify,
+    uint64_t OutputsState::* generation)
+    : notify{notify},
+      generation{generation}
+{
+}
+
+void usc::MirScreen::subscribe(
+    std::shared_ptr<Subscription>& current,
+    std::shared_ptr<Subscription> const& subscription)
+{
+    // Held until the handler has been called with the current state, so
+    // that a concurrent notification can't pass it an older one
+    std::lock_guard<std::mutex> lock{subscription->mutex};
+
+    auto const previous = std::atomic_exchange(&current, subscription);
+
+    // Waits for any call of the previous handler in progress, and stops
+    // those about to start, so that no call of it happens after we return
+    {
+        std::lock_guard<std::mutex> previous_lock{previous->mutex};
+        previous->retired = true;
+    }
+
+    auto const state = std::atomic_load(&outputs_state);
+    subscription->notified_generation = (*state).*subscription->generation;
+    subscription->notify(*state);
+}
+
+void usc::MirScreen::notify(std::shared_ptr<Subscription> const& current)
+{
+    auto const subscription = std::atomic_load(&current);
+
+    std::lock_guard<std::mutex> lock{subscription->mutex};
+
+    // Loaded under the subscription lock, so that whoever notifies last
+    // passes the latest state
+    auto const state = std::atomic_load(&outputs_state);
+    auto const generation = (*state).*subscription->generation;
+
+    if (subscription->retired || generation <= subscription->notified_generation)
+        return;
+
+    subscription->notified_generation = generation;
+    subscription->notify(*state);
+}
+
 void usc::MirScreen::set_power_mode(MirPowerMode mode, SetPowerModeFilter const& filter)
+{
+    auto const state = std::atomic_load(&outputs_state);
+    std::vector<OutputId> selected_ids;
+
+    for (auto const& output : state->outputs)
+    {
+        if (filter(output))
+            selected_ids.push_back(output.id);
+    }
+
+    std::unique_lock<std::mutex> lock{power_mutex};
+    auto const base = configuration;
+    lock.unlock();
+
+    auto const applied = apply_power_modes(*base, power_changes(*base, selected_ids, mode));
+
+    lock.lock();
+
+    // Unless a newer configuration has been reported in the meantime
+    if (applied && configuration == base)
+        configuration = applied;
+}
+
+usc::MirScreen::PowerModes usc::MirScreen::power_changes(
+    mg::DisplayConfiguration const& base,
+    std::vector<OutputId> const& selected_ids,
+    MirPowerMode mode) const
+{
+    PowerModes changes;
+
+    base.for_each_output(
+        [&](mg::DisplayConfigurationOutput const& output)
+        {
+            auto const id = output.id.as_value();
+
+            if (output.connected &&
+                output.used &&
+                output.power_mode != mode &&
+                std::find(selected_ids.begin(), selected_ids.end(), id) != selected_ids.end())
+            {
+                changes[id] = mode;
+            }
+        });
+
+    return changes;
+}
+
+std::shared_ptr<mg::DisplayConfiguration const> usc::MirScreen::apply_power_modes(
+    mg::DisplayConfiguration const& base, PowerModes const& changes)
 try
 {
-    std::shared_ptr<mg::DisplayConfiguration> displayConfig = display->configuration();
+    // Requests for the power modes the outputs are already in cost nothing
+    if (changes.empty())
+        return nullptr;
+
+    std::shared_ptr<mg::DisplayConfiguration> displayConfig = base.clone();
 
     displayConfig->for_each_output(
         [&](const mg::UserDisplayConfigurationOutput displayConfigOutput) {
-            if (displayConfigOutput.connected &&
-                displayConfigOutput.used &&
-                filter(displayConfigOutput))
-            {
-                displayConfigOutput.power_mode = mode;
-            }
+            auto const change = changes.find(displayConfigOutput.id.as_value());
+
+            if (change != changes.end())
+                displayConfigOutput.power_mode = change->second;
         }
     );
 
+    auto const needs_compositing = has_active_outputs(*displayConfig);
+
+    // Power mode changes normally leave the display buffers in place, in
+    // which case the outputs we don't touch keep being composited
+    // throughout. The compositor only needs to be started if it was
+    // stopped along with the last active output, or stopped if we have
+    // just turned that off; both are no-ops otherwise.
+    tracer->trace("display_configure_begin");
+
+    if (display->apply_if_configuration_preserves_display_buffers(*displayConfig))
+    {
+        tracer->trace("display_configure_end");
+
+        if (needs_compositing)
+        {
+            compositor->start();
+            tracer->trace("compositor_started");
+        }
+        else
+        {
+            compositor->stop();
+        }
+
+        return displayConfig;
+    }
+
     compositor->stop();
 
     display->configure(*displayConfig.get());
+    tracer->trace("display_configure_end");
 
-    if (has_active_outputs(*displayConfig))
+    if (needs_compositing)
+    {
         compositor->start();
+        tracer->trace("compositor_started");
+    }
+
+    return displayConfig;
 }
 catch (std::exception const&)
 {
     log_exception_in(__func__);
+    return nullptr;
 }
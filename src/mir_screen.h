@@ -21,29 +21,38 @@
 #include "screen.h"
 
 #include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
 #include <memory>
 #include <mutex>
+#include <vector>
 
 namespace mir
 {
 namespace compositor { class Compositor; }
-namespace graphics {class Display; struct UserDisplayConfigurationOutput;}
+namespace graphics {class Display; class DisplayConfiguration; struct UserDisplayConfigurationOutput;}
 }
 
 namespace usc
 {
+class Tracer;
 
 class MirScreen: public Screen, public mir::graphics::DisplayConfigurationObserver
 {
 public:
     MirScreen(std::shared_ptr<mir::compositor::Compositor> const& compositor,
-              std::shared_ptr<mir::graphics::Display> const& display);
+              std::shared_ptr<mir::graphics::Display> const& display,
+              std::shared_ptr<Tracer> const& tracer);
     ~MirScreen();
 
     // From Screen
     void turn_on(OutputFilter output_filter) override;
     void turn_off(OutputFilter output_filter) override;
     void register_active_outputs_handler(ActiveOutputsHandler const& handler) override;
+    void turn_on_output(OutputId id) override;
+    void turn_off_output(OutputId id) override;
+    void register_outputs_handler(OutputsHandler const& handler) override;
 
     // From DisplayConfigurationObserver
     void initial_configuration(
@@ -66,15 +75,71 @@ public:
         std::exception const&) override;
 
 private:
-    using SetPowerModeFilter = bool(*)(mir::graphics::UserDisplayConfigurationOutput const&);
+    using SetPowerModeFilter = std::function<bool(Output const&)>;
+    using PowerModes = std::map<OutputId, MirPowerMode>;
     void set_power_mode(MirPowerMode mode, SetPowerModeFilter const& filter);
+    PowerModes power_changes(
+        mir::graphics::DisplayConfiguration const& base,
+        std::vector<OutputId> const& selected_ids,
+        MirPowerMode mode) const;
+    std::shared_ptr<mir::graphics::DisplayConfiguration const> apply_power_modes(
+        mir::graphics::DisplayConfiguration const& base, PowerModes const& changes);
+
+    // The outputs as of the latest applied configuration. Each change
+    // publishes a new state, so that readers never need to lock.
+    struct OutputsState
+    {
+        // Bumped on every applied configuration
+        uint64_t generation;
+        // Bumped only when the outputs table changes
+        uint64_t outputs_generation;
+        Outputs outputs;
+        ActiveOutputs active_outputs;
+    };
+
+    // A registered handler, called outside any lock on the outputs state.
+    // Calls are serialized by the subscription mutex, and only ever made
+    // with a state newer than the last one passed to the handler.
+    struct Subscription
+    {
+        Subscription(
+            std::function<void(OutputsState const&)> const& notify,
+            uint64_t OutputsState::* generation);
+
+        std::function<void(OutputsState const&)> const notify;
+        // The part of the state the handler is interested in
+        uint64_t OutputsState::* const generation;
+
+        std::mutex mutex;
+        uint64_t notified_generation{0};
+        bool retired{false};
+    };
+
+    void subscribe(
+        std::shared_ptr<Subscription>& current,
+        std::shared_ptr<Subscription> const& subscription);
+    void notify(std::shared_ptr<Subscription> const& current);
 
     std::shared_ptr<mir::compositor::Compositor> const compositor;
     std::shared_ptr<mir::graphics::Display> const display;
+    std::shared_ptr<Tracer> const tracer;
+
+    // Only serializes updates of the outputs state; it is read with
+    // atomic loads
+    std::mutex outputs_update_mutex;
+    std::shared_ptr<OutputsState const> outputs_state;
+    // Replaced with atomic exchanges on registration
+    std::shared_ptr<Subscription> active_outputs_subscription;
+    std::shared_ptr<Subscription> outputs_subscription;
 
-    std::mutex active_outputs_mutex;
-    ActiveOutputsHandler active_outputs_handler;
-    ActiveOutputs active_outputs;
+    // Power requests are collapsed before they get here (see
+    // UnityDisplayService), so this only guards the configuration against
+    // the Mir notifications that replace it
+    std::mutex power_mutex;
+    // The configuration currently applied, shared with whoever handed it
+    // to us. Power changes are made on a copy of it, which then replaces
+    // it, so the display never has to be queried on the power path.
+    std::shared_ptr<mir::graphics::DisplayConfiguration const> configuration;
 };
 
 }
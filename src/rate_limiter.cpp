@@ -0,0 +1,128 @@
+/*
+ * Copyright © 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "rate_limiter.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <boost/throw_exception.hpp>
+
+unsigned int const usc::RateLimiter::default_burst{50};
+double const usc::RateLimiter::default_calls_per_second{20.0};
+std::size_t const usc::RateLimiter::max_tracked_senders{64};
+
+usc::RateLimiter::RateLimiter(unsigned int burst, double calls_per_second)
+    : burst{static_cast<double>(burst)},
+      calls_per_second{calls_per_second}
+{
+    if (burst == 0 || calls_per_second <= 0.0)
+        BOOST_THROW_EXCEPTION(std::logic_error("RateLimiter needs a positive burst and rate"));
+}
+
+bool usc::RateLimiter::admit(DBusConnection* connection, DBusMessage* message)
+{
+    auto const sender = dbus_message_get_sender(message);
+
+    if (!sender)
+        return admit(connection, Clock::now());
+
+    sender_key.assign(sender);
+    return admit(sender_key, Clock::now());
+}
+
+bool usc::RateLimiter::admit(std::string const& sender, Clock::time_point now)
+{
+    auto iter = buckets.find(sender);
+
+    if (iter == buckets.end())
+    {
+        if (buckets.size() >= max_tracked_senders)
+            make_room_for_sender(now);
+
+        iter = buckets.emplace(sender, Bucket{burst, now}).first;
+    }
+
+    return take_token(iter->second, now);
+}
+
+bool usc::RateLimiter::admit(DBusConnection* peer, Clock::time_point now)
+{
+    // Peers are forgotten when they disconnect, so there are never more
+    // buckets than connections
+    auto iter = peer_buckets.find(peer);
+
+    if (iter == peer_buckets.end())
+        iter = peer_buckets.emplace(peer, Bucket{burst, now}).first;
+
+    return take_token(iter->second, now);
+}
+
+void usc::RateLimiter::forget_peer(DBusConnection* peer)
+{
+    peer_buckets.erase(peer);
+}
+
+bool usc::RateLimiter::take_token(Bucket& bucket, Clock::time_point now)
+{
+    std::chrono::duration<double> const elapsed{now - bucket.last_refill};
+    bucket.tokens = std::min(burst, bucket.tokens + elapsed.count() * calls_per_second);
+    bucket.last_refill = now;
+
+    if (bucket.tokens < 1.0)
+        return false;
+
+    bucket.tokens -= 1.0;
+    return true;
+}
+
+std::size_t usc::RateLimiter::tracked_senders() const
+{
+    return buckets.size();
+}
+
+void usc::RateLimiter::make_room_for_sender(Clock::time_point now)
+{
+    // A bucket that would have refilled completely is indistinguishable
+    // from a new one. If every sender is still busy, the one closest to
+    // that goes, which forgives it the fewest calls.
+    auto fullest = buckets.end();
+    double fullest_tokens{0.0};
+    bool forgot_any{false};
+
+    for (auto iter = buckets.begin(); iter != buckets.end();)
+    {
+        std::chrono::duration<double> const elapsed{now - iter->second.last_refill};
+        double const tokens{iter->second.tokens + elapsed.count() * calls_per_second};
+
+        if (tokens >= burst)
+        {
+            iter = buckets.erase(iter);
+            forgot_any = true;
+            continue;
+        }
+
+        if (fullest == buckets.end() || tokens > fullest_tokens)
+        {
+            fullest = iter;
+            fullest_tokens = tokens;
+        }
+        ++iter;
+    }
+
+    if (!forgot_any && fullest != buckets.end())
+        buckets.erase(fullest);
+}
@@ -0,0 +1,83 @@
+/*
+ * Copyright © 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef USC_RATE_LIMITER_H_
+#define USC_RATE_LIMITER_H_
+
+#include <dbus/dbus.h>
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+
+namespace usc
+{
+
+/*
+ * Per-sender token bucket admission control for incoming DBus calls.
+ * Each sender may make up to `burst` calls at once, and then
+ * `calls_per_second` calls on average. Not thread safe; meant to be used
+ * from the loop thread of the service that owns it.
+ */
+class RateLimiter
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static unsigned int const default_burst;
+    static double const default_calls_per_second;
+    // Beyond this many senders, idle ones are forgotten to make room for
+    // new ones, or the least limited one if none is idle
+    static std::size_t const max_tracked_senders;
+
+    RateLimiter(unsigned int burst, double calls_per_second);
+
+    // Whether the call can go ahead, taking a token from its sender if so.
+    // Calls from peer-to-peer connections, which have no sender, are
+    // accounted to their connection.
+    bool admit(DBusConnection* connection, DBusMessage* message);
+    bool admit(std::string const& sender, Clock::time_point now);
+    bool admit(DBusConnection* peer, Clock::time_point now);
+
+    // Drops the bucket of a peer-to-peer connection that has gone away,
+    // so that a later connection at the same address starts afresh
+    void forget_peer(DBusConnection* peer);
+
+    std::size_t tracked_senders() const;
+
+private:
+    struct Bucket
+    {
+        double tokens;
+        Clock::time_point last_refill;
+    };
+
+    bool take_token(Bucket& bucket, Clock::time_point now);
+    void make_room_for_sender(Clock::time_point now);
+
+    double const burst;
+    double const calls_per_second;
+    std::unordered_map<std::string,Bucket> buckets;
+    std::unordered_map<DBusConnection*,Bucket> peer_buckets;
+    // Reused to look up senders, so that calls from known senders
+    // don't allocate
+    std::string sender_key;
+};
+
+}
+
+#endif
@@ -19,6 +19,7 @@
 
 #include <mir_toolkit/common.h>
 #include <functional>
+#include <vector>
 
 namespace usc
 {
@@ -42,6 +43,37 @@ using ActiveOutputsHandler = std::function<void(ActiveOutputs const&)>;
 
 enum class OutputFilter { all, internal, external };
 
+using OutputId = int;
+enum class OutputType { internal, external };
+
+struct Output
+{
+    OutputId id;
+    OutputType type;
+    bool connected;
+    bool used;
+    bool powered_on;
+
+    // Whether the output is actually showing something
+    bool active() const
+    {
+        return connected && used && powered_on;
+    }
+
+    bool operator==(Output const& other) const
+    {
+        return id == other.id &&
+               type == other.type &&
+               connected == other.connected &&
+               used == other.used &&
+               powered_on == other.powered_on;
+    }
+};
+
+// Ordered by output id
+using Outputs = std::vector<Output>;
+using OutputsHandler = std::function<void(Outputs const&)>;
+
 class Screen
 {
 public:
@@ -52,6 +84,13 @@ public:
     virtual void register_active_outputs_handler(
         ActiveOutputsHandler const& handler) = 0;
 
+    // Unknown ids are ignored
+    virtual void turn_on_output(OutputId id) = 0;
+    virtual void turn_off_output(OutputId id) = 0;
+    // Like the active outputs handler, called on registration and then
+    // whenever any output changes
+    virtual void register_outputs_handler(OutputsHandler const& handler) = 0;
+
 protected:
     Screen() = default;
     Screen(Screen const&) = delete;
@@ -18,6 +18,7 @@
 #include "power_button_event_sink.h"
 #include "user_activity_event_sink.h"
 #include "clock.h"
+#include "tracer.h"
 
 #include <mir_toolkit/events/input/input_event.h>
 
@@ -27,10 +28,12 @@
 usc::ScreenEventHandler::ScreenEventHandler(
     std::shared_ptr<PowerButtonEventSink> const& power_button_event_sink,
     std::shared_ptr<UserActivityEventSink> const& user_activity_event_sink,
-    std::shared_ptr<Clock> const& clock)
+    std::shared_ptr<Clock> const& clock,
+    std::shared_ptr<Tracer> const& tracer)
     : power_button_event_sink{power_button_event_sink},
       user_activity_event_sink{user_activity_event_sink},
       clock{clock},
+      tracer{tracer},
       last_activity_changing_power_state_event_time{-event_period},
       last_activity_extending_power_state_event_time{-event_period}
 {
@@ -51,9 +54,17 @@ bool usc::ScreenEventHandler::handle(MirEvent const& event)
         {
             auto const action = mir_keyboard_event_action(kev);
             if (action == mir_keyboard_action_down)
+            {
+                // Usually makes powerd request a power change, which
+                // the trace links back to this press
+                tracer->trace_cause("power_key_down");
                 power_button_event_sink->notify_press();
+            }
             else if (action == mir_keyboard_action_up)
+            {
+                tracer->trace("power_key_up");
                 power_button_event_sink->notify_release();
+            }
         }
         // we might want to come up with a whole range of media player related keys
         else if (mir_keyboard_event_scan_code(kev) == KEY_VOLUMEDOWN||
@@ -29,6 +29,7 @@ namespace usc
 class PowerButtonEventSink;
 class UserActivityEventSink;
 class Clock;
+class Tracer;
 
 class ScreenEventHandler : public mir::input::EventFilter
 {
@@ -36,7 +37,8 @@ public:
     ScreenEventHandler(
         std::shared_ptr<PowerButtonEventSink> const& power_button_event_sink,
         std::shared_ptr<UserActivityEventSink> const& user_activity_event_sink,
-        std::shared_ptr<Clock> const& clock);
+        std::shared_ptr<Clock> const& clock,
+        std::shared_ptr<Tracer> const& tracer);
 
     bool handle(MirEvent const& event) override;
 
@@ -47,6 +49,7 @@ private:
     std::shared_ptr<PowerButtonEventSink> const power_button_event_sink;
     std::shared_ptr<UserActivityEventSink> const user_activity_event_sink;
     std::shared_ptr<Clock> const clock;
+    std::shared_ptr<Tracer> const tracer;
     std::chrono::milliseconds const event_period{500};
 
     std::mutex event_mutex;
@@ -30,10 +30,13 @@
 #include "unity_input_service.h"
 #include "unity_power_button_event_sink.h"
 #include "unity_user_activity_event_sink.h"
+#include "dbus_connection_handle.h"
 #include "dbus_connection_thread.h"
 #include "dbus_event_loop.h"
+#include "dbus_peer_server.h"
 #include "display_configuration_policy.h"
 #include "steady_clock.h"
+#include "tracer.h"
 
 #include <mir/cookie/authority.h>
 #include <mir/input/cursor_listener.h>
@@ -48,6 +51,7 @@
 #include <boost/exception/all.hpp>
 
 #include <iostream>
+#include <vector>
 
 namespace msh = mir::shell;
 namespace ms = mir::scene;
@@ -148,6 +152,11 @@ const char* const dm_from_fd = "from-dm-fd";
 const char* const dm_to_fd = "to-dm-fd";
 const char* const dm_stub = "debug-without-dm";
 const char* const dm_stub_active = "debug-active-session-name";
+const char* const dbus_stall_threshold = "dbus-stall-threshold";
+const char* const dbus_loop_per_service = "dbus-loop-per-service";
+const char* const dbus_shared_connection = "dbus-shared-connection";
+const char* const active_outputs_signal_window = "active-outputs-signal-window";
+const char* const dbus_peer_address = "dbus-peer-address";
 }
 
 usc::Server::Server(int argc, char** argv)
@@ -163,6 +172,16 @@ usc::Server::Server(int argc, char** argv)
     add_configuration_option("spinner", "Path to spinner executable",  mir::OptionType::string);
     add_configuration_option("public-socket", "Make the socket file publicly writable",  mir::OptionType::boolean);
     add_configuration_option("enable-hardware-cursor", "Enable the hardware cursor (disabled by default)",  mir::OptionType::boolean);
+    add_configuration_option(dbus_stall_threshold, "Warn when handling DBus events blocks for longer than this many milliseconds, 0 to disable [int]",
+        static_cast<int>(DBusEventLoop::default_stall_threshold.count()));
+    add_configuration_option(dbus_loop_per_service, "Handle the display and input DBus services on separate threads",
+        mir::OptionType::boolean);
+    add_configuration_option(dbus_shared_connection, "Use a single system bus connection for all DBus services. All of them are then handled with the high priority of the display service (implies no dbus-loop-per-service)",
+        mir::OptionType::boolean);
+    add_configuration_option(dbus_peer_address, "Also serve the display and input DBus services to peers connecting directly to this address, e.g. unix:path=/run/usc-dbus (implies no dbus-loop-per-service)",
+        mir::OptionType::string);
+    add_configuration_option(active_outputs_signal_window, "Minimum interval in milliseconds between ActiveOutputs change signals, 0 to signal every change [int]",
+        static_cast<int>(UnityDisplayService::default_active_outputs_window.count()));
     add_display_configuration_options_to(*this);
 
     set_command_line(argc, const_cast<char const **>(argv));
@@ -295,7 +314,8 @@ std::shared_ptr<usc::Screen> usc::Server::the_screen()
         {
             auto mir_screen = std::make_shared<MirScreen>(
                 the_compositor(),
-                the_display());
+                the_display(),
+                the_tracer());
 
             the_display_configuration_observer_registrar()->register_interest(mir_screen);
 
@@ -311,7 +331,8 @@ std::shared_ptr<mi::EventFilter> usc::Server::the_screen_event_handler()
             return std::make_shared<ScreenEventHandler>(
                 the_power_button_event_sink(),
                 the_user_activity_event_sink(),
-                the_clock());
+                the_clock(),
+                the_tracer());
         });
 }
 
@@ -324,22 +345,55 @@ std::shared_ptr<usc::Clock> usc::Server::the_clock()
         });
 }
 
+std::shared_ptr<usc::Tracer> usc::Server::the_tracer()
+{
+    return tracer(
+        [this]
+        {
+            return std::make_shared<Tracer>();
+        });
+}
+
 std::shared_ptr<usc::DBusEventLoop> usc::Server::the_dbus_event_loop()
 {
     return dbus_loop(
         [this]
         {
-            return std::make_shared<DBusEventLoop>();
+            return std::make_shared<DBusEventLoop>(
+                std::chrono::milliseconds{the_options()->get<int>(dbus_stall_threshold)});
         });
 
 }
 
+std::shared_ptr<usc::DBusEventLoop> usc::Server::the_input_dbus_event_loop()
+{
+    return input_dbus_loop(
+        [this]
+        {
+            // A connection can only be serviced by a single loop
+            if (!the_options()->get(dbus_loop_per_service, false) ||
+                share_dbus_connection() ||
+                serve_dbus_peers())
+            {
+                return the_dbus_event_loop();
+            }
+
+            return std::make_shared<DBusEventLoop>(
+                std::chrono::milliseconds{the_options()->get<int>(dbus_stall_threshold)});
+        });
+}
+
 std::shared_ptr<usc::DBusConnectionThread> usc::Server::the_dbus_connection_thread()
 {
     return dbus_thread(
         [this]
         {
-            return std::make_shared<DBusConnectionThread>(the_dbus_event_loop());
+            std::vector<std::shared_ptr<DBusEventLoop>> loops{the_dbus_event_loop()};
+
+            if (the_input_dbus_event_loop() != the_dbus_event_loop())
+                loops.push_back(the_input_dbus_event_loop());
+
+            return std::make_shared<DBusConnectionThread>(loops);
         });
 }
 
@@ -348,10 +402,25 @@ std::shared_ptr<usc::UnityDisplayService> usc::Server::the_unity_display_service
     return unity_display_service(
         [this]
         {
+            std::chrono::milliseconds const active_outputs_window{
+                the_options()->get<int>(active_outputs_signal_window)};
+
+            if (share_dbus_connection())
+            {
+                return std::make_shared<UnityDisplayService>(
+                        the_dbus_event_loop(),
+                        the_shared_dbus_connection(),
+                        the_screen(),
+                        the_tracer(),
+                        active_outputs_window);
+            }
+
             return std::make_shared<UnityDisplayService>(
                     the_dbus_event_loop(),
                     dbus_bus_address(),
-                    the_screen());
+                    the_screen(),
+                    the_tracer(),
+                    active_outputs_window);
         });
 }
 
@@ -360,7 +429,12 @@ std::shared_ptr<usc::PowerButtonEventSink> usc::Server::the_power_button_event_s
     return power_button_event_sink(
         [this]
         {
-            return std::make_shared<UnityPowerButtonEventSink>(dbus_bus_address());
+            if (share_dbus_connection())
+                return std::make_shared<UnityPowerButtonEventSink>(
+                    the_dbus_event_loop(), the_shared_dbus_connection(), the_tracer());
+
+            return std::make_shared<UnityPowerButtonEventSink>(
+                the_dbus_event_loop(), dbus_bus_address(), the_tracer());
         });
 }
 
@@ -369,7 +443,10 @@ std::shared_ptr<usc::UserActivityEventSink> usc::Server::the_user_activity_event
     return user_activity_event_sink(
         [this]
         {
-            return std::make_shared<UnityUserActivityEventSink>(dbus_bus_address());
+            if (share_dbus_connection())
+                return std::make_shared<UnityUserActivityEventSink>(the_dbus_event_loop(), the_shared_dbus_connection());
+
+            return std::make_shared<UnityUserActivityEventSink>(the_dbus_event_loop(), dbus_bus_address());
         });
 }
 
@@ -378,13 +455,70 @@ std::shared_ptr<usc::UnityInputService> usc::Server::the_unity_input_service()
     return unity_input_service(
         [this]
         {
+            if (share_dbus_connection())
+            {
+                return std::make_shared<UnityInputService>(
+                        the_input_dbus_event_loop(),
+                        the_shared_dbus_connection(),
+                        the_input_configuration());
+            }
+
             return std::make_shared<UnityInputService>(
-                    the_dbus_event_loop(),
+                    the_input_dbus_event_loop(),
                     dbus_bus_address(),
                     the_input_configuration());
         });
 }
 
+std::shared_ptr<usc::DBusPeerServer> usc::Server::the_dbus_peer_server()
+{
+    return dbus_peer_server(
+        [this]
+        {
+            if (!serve_dbus_peers())
+                return std::shared_ptr<DBusPeerServer>{};
+
+            auto const display_service = the_unity_display_service();
+            auto const input_service = the_unity_input_service();
+
+            // Peers are there to cut latency on the wake-up path, so
+            // handle them with high priority like the display service
+            return std::make_shared<DBusPeerServer>(
+                the_dbus_event_loop(),
+                the_options()->get<std::string>(dbus_peer_address),
+                DBusEventLoop::Priority::high,
+                [display_service, input_service] (std::shared_ptr<DBusConnectionHandle> const& peer)
+                {
+                    display_service->add_peer_connection(peer);
+                    input_service->add_peer_connection(peer);
+                },
+                [display_service, input_service] (std::shared_ptr<DBusConnectionHandle> const& peer)
+                {
+                    input_service->remove_peer_connection(peer);
+                    display_service->remove_peer_connection(peer);
+                });
+        });
+}
+
+std::shared_ptr<usc::DBusConnectionHandle> usc::Server::the_shared_dbus_connection()
+{
+    return shared_dbus_connection(
+        [this]
+        {
+            return std::make_shared<DBusConnectionHandle>(dbus_bus_address());
+        });
+}
+
+bool usc::Server::share_dbus_connection()
+{
+    return the_options()->get(dbus_shared_connection, false);
+}
+
+bool usc::Server::serve_dbus_peers()
+{
+    return the_options()->is_set(dbus_peer_address);
+}
+
 std::string usc::Server::dbus_bus_address()
 {
     static char const* const default_bus_address{"unix:path=/var/run/dbus/system_bus_socket"};
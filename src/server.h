@@ -45,9 +45,12 @@ class PowerButtonEventSink;
 class UserActivityEventSink;
 class InputConfiguration;
 class UnityInputService;
+class DBusConnectionHandle;
 class DBusConnectionThread;
 class DBusEventLoop;
+class DBusPeerServer;
 class Clock;
+class Tracer;
 
 class Server : private mir::Server
 {
@@ -73,8 +76,13 @@ public:
     virtual std::shared_ptr<PowerButtonEventSink> the_power_button_event_sink();
     virtual std::shared_ptr<UserActivityEventSink> the_user_activity_event_sink();
     virtual std::shared_ptr<DBusEventLoop> the_dbus_event_loop();
+    // Same as the_dbus_event_loop() unless running a loop per service
+    virtual std::shared_ptr<DBusEventLoop> the_input_dbus_event_loop();
     virtual std::shared_ptr<DBusConnectionThread> the_dbus_connection_thread();
+    // Null unless --dbus-peer-address is given
+    virtual std::shared_ptr<DBusPeerServer> the_dbus_peer_server();
     virtual std::shared_ptr<Clock> the_clock();
+    virtual std::shared_ptr<Tracer> the_tracer();
 
     bool show_version()
     {
@@ -118,6 +126,10 @@ private:
 
     virtual std::shared_ptr<SessionSwitcher> the_session_switcher();
     std::string dbus_bus_address();
+    // Only used with --dbus-shared-connection
+    std::shared_ptr<DBusConnectionHandle> the_shared_dbus_connection();
+    bool share_dbus_connection();
+    bool serve_dbus_peers();
 
     mir::CachedPtr<Spinner> spinner;
     mir::CachedPtr<DMConnection> dm_connection;
@@ -127,11 +139,15 @@ private:
     mir::CachedPtr<mir::input::EventFilter> screen_event_handler;
     mir::CachedPtr<DBusConnectionThread> dbus_thread;
     mir::CachedPtr<DBusEventLoop> dbus_loop;
+    mir::CachedPtr<DBusEventLoop> input_dbus_loop;
+    mir::CachedPtr<DBusConnectionHandle> shared_dbus_connection;
+    mir::CachedPtr<DBusPeerServer> dbus_peer_server;
     mir::CachedPtr<UnityDisplayService> unity_display_service;
     mir::CachedPtr<PowerButtonEventSink> power_button_event_sink;
     mir::CachedPtr<UserActivityEventSink> user_activity_event_sink;
     mir::CachedPtr<UnityInputService> unity_input_service;
     mir::CachedPtr<Clock> clock;
+    mir::CachedPtr<Tracer> tracer;
 };
 
 }
@@ -121,6 +121,7 @@ void usc::SystemCompositor::run()
             composite_filter->append(screen_event_handler);
 
             unity_input_service = server->the_unity_input_service();
+            dbus_peer_server = server->the_dbus_peer_server();
             dbus_service_thread = server->the_dbus_connection_thread();
         });
 
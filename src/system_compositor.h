@@ -41,6 +41,7 @@ class Screen;
 class UnityDisplayService;
 class UnityInputService;
 class DBusConnectionThread;
+class DBusPeerServer;
 
 class SystemCompositor
 {
@@ -56,6 +57,8 @@ private:
     std::shared_ptr<mir::input::EventFilter> screen_event_handler;
     std::shared_ptr<UnityDisplayService> unity_display_service;
     std::shared_ptr<UnityInputService> unity_input_service;
+    // Destroyed after the DBus thread has stopped
+    std::shared_ptr<DBusPeerServer> dbus_peer_server;
     std::shared_ptr<DBusConnectionThread> dbus_service_thread;
 };
 
@@ -0,0 +1,155 @@
+/*
+ * Copyright © 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef USC_TASK_H_
+#define USC_TASK_H_
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace usc
+{
+
+/*
+ * Move-only void() callable that always stores its target inline, so
+ * creating, moving and running a Task never touches the heap. Targets
+ * that don't fit in inline_size bytes are rejected at compile time.
+ */
+class Task
+{
+public:
+    static std::size_t const inline_size = 64;
+
+    Task() noexcept
+        : ops{nullptr}
+    {
+    }
+
+    template <typename F,
+              typename = typename std::enable_if<
+                  !std::is_same<typename std::decay<F>::type, Task>::value>::type>
+    Task(F&& f)
+        : ops{&ops_for<typename std::decay<F>::type>}
+    {
+        using Target = typename std::decay<F>::type;
+
+        static_assert(sizeof(Target) <= inline_size,
+                      "Task target is too large for inline storage");
+        static_assert(alignof(Target) <= alignof(std::max_align_t),
+                      "Task target is over-aligned");
+        static_assert(std::is_nothrow_move_constructible<Target>::value,
+                      "Task target must be nothrow move constructible");
+
+        new (&storage) Target(std::forward<F>(f));
+    }
+
+    Task(Task&& other) noexcept
+        : ops{other.ops}
+    {
+        if (ops)
+        {
+            ops->move(&storage, &other.storage);
+            other.reset();
+        }
+    }
+
+    Task& operator=(Task&& other) noexcept
+    {
+        if (this != &other)
+        {
+            reset();
+            if (other.ops)
+            {
+                ops = other.ops;
+                ops->move(&storage, &other.storage);
+                other.reset();
+            }
+        }
+
+        return *this;
+    }
+
+    ~Task()
+    {
+        reset();
+    }
+
+    void operator()()
+    {
+        ops->invoke(&storage);
+    }
+
+    explicit operator bool() const
+    {
+        return ops != nullptr;
+    }
+
+    void reset() noexcept
+    {
+        if (ops)
+        {
+            ops->destroy(&storage);
+            ops = nullptr;
+        }
+    }
+
+private:
+    Task(Task const&) = delete;
+    Task& operator=(Task const&) = delete;
+
+    struct Ops
+    {
+        void (*invoke)(void*);
+        void (*move)(void*, void*);
+        void (*destroy)(void*);
+    };
+
+    template <typename Target>
+    static void invoke_target(void* target)
+    {
+        (*static_cast<Target*>(target))();
+    }
+
+    template <typename Target>
+    static void move_target(void* dst, void* src)
+    {
+        new (dst) Target(std::move(*static_cast<Target*>(src)));
+    }
+
+    template <typename Target>
+    static void destroy_target(void* target)
+    {
+        static_cast<Target*>(target)->~Target();
+    }
+
+    template <typename Target>
+    static Ops const ops_for;
+
+    typename std::aligned_storage<inline_size, alignof(std::max_align_t)>::type storage;
+    Ops const* ops;
+};
+
+template <typename Target>
+Task::Ops const Task::ops_for{
+    &Task::invoke_target<Target>,
+    &Task::move_target<Target>,
+    &Task::destroy_target<Target>};
+
+}
+
+#endif
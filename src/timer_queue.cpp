@@ -0,0 +1,140 @@
+/*
+ * Copyright © 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "timer_queue.h"
+
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include <system_error>
+#include <boost/throw_exception.hpp>
+
+namespace
+{
+
+timespec time_point_to_timespec(usc::TimerQueue::Clock::time_point time_point)
+{
+    using namespace std::chrono;
+
+    auto const since_epoch = time_point.time_since_epoch();
+    auto const sec = duration_cast<seconds>(since_epoch);
+    auto const nsec = duration_cast<nanoseconds>(since_epoch - sec);
+
+    return timespec{static_cast<time_t>(sec.count()), static_cast<long>(nsec.count())};
+}
+
+}
+
+usc::TimerQueue::TimerQueue()
+    : timer_fd{timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK|TFD_CLOEXEC)},
+      next_id{1},
+      armed_deadline{Clock::time_point::max()}
+{
+    if (timer_fd == -1)
+    {
+        BOOST_THROW_EXCEPTION(
+            std::system_error(errno, std::system_category(), "timerfd_create"));
+    }
+}
+
+int usc::TimerQueue::fd() const
+{
+    return timer_fd;
+}
+
+usc::TimerQueue::TimerId usc::TimerQueue::schedule(
+    Clock::time_point deadline, Task&& callback)
+{
+    std::lock_guard<std::mutex> lock{mutex};
+
+    auto const id = next_id++;
+    auto const iter = timers.emplace(deadline, Timer{id, std::move(callback)});
+    timers_by_id[id] = iter;
+
+    // The timerfd only needs to be touched when the earliest deadline moves
+    // earlier. A later or cancelled deadline at most causes a spurious
+    // wakeup, after which the timerfd is re-armed for the real earliest one.
+    if (deadline < armed_deadline)
+        arm_for(deadline);
+
+    return id;
+}
+
+bool usc::TimerQueue::cancel(TimerId id)
+{
+    std::lock_guard<std::mutex> lock{mutex};
+
+    auto const iter = timers_by_id.find(id);
+    if (iter == timers_by_id.end())
+        return false;
+
+    timers.erase(iter->second);
+    timers_by_id.erase(iter);
+
+    return true;
+}
+
+void usc::TimerQueue::dispatch_expired()
+{
+    uint64_t expirations;
+    if (read(timer_fd, &expirations, sizeof expirations));
+
+    auto const now = Clock::now();
+
+    // Pop expired timers one at a time, so that a callback can still
+    // cancel any other timer that hasn't run yet
+    while (true)
+    {
+        Task callback;
+
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+
+            if (timers.empty() || timers.begin()->first > now)
+            {
+                armed_deadline = Clock::time_point::max();
+                if (!timers.empty())
+                    arm_for(timers.begin()->first);
+                break;
+            }
+
+            auto const iter = timers.begin();
+            callback = std::move(iter->second.callback);
+            timers_by_id.erase(iter->second.id);
+            timers.erase(iter);
+        }
+
+        callback();
+    }
+}
+
+void usc::TimerQueue::arm_for(Clock::time_point deadline)
+{
+    itimerspec spec{};
+    spec.it_value = time_point_to_timespec(deadline);
+
+    // A zero it_value would disarm the timer
+    if (spec.it_value.tv_sec == 0 && spec.it_value.tv_nsec == 0)
+        spec.it_value.tv_nsec = 1;
+
+    if (timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &spec, nullptr) == -1)
+    {
+        BOOST_THROW_EXCEPTION(
+            std::system_error(errno, std::system_category(), "timerfd_settime"));
+    }
+
+    armed_deadline = deadline;
+}
@@ -0,0 +1,76 @@
+/*
+ * Copyright © 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef USC_TIMER_QUEUE_H_
+#define USC_TIMER_QUEUE_H_
+
+#include "task.h"
+
+#include <mir/fd.h>
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+
+namespace usc
+{
+
+/*
+ * Multiplexes any number of deadlines onto a single timerfd, which is
+ * always armed for the earliest pending deadline. The owner is expected
+ * to poll fd() and call dispatch_expired() when it becomes readable.
+ */
+class TimerQueue
+{
+public:
+    using Clock = std::chrono::steady_clock;
+    using TimerId = uint64_t;
+
+    TimerQueue();
+
+    int fd() const;
+
+    TimerId schedule(Clock::time_point deadline, Task&& callback);
+    bool cancel(TimerId id);
+    void dispatch_expired();
+
+private:
+    TimerQueue(TimerQueue const&) = delete;
+    TimerQueue& operator=(TimerQueue const&) = delete;
+
+    struct Timer
+    {
+        TimerId id;
+        Task callback;
+    };
+    using Timers = std::multimap<Clock::time_point,Timer>;
+
+    void arm_for(Clock::time_point deadline);
+
+    mir::Fd const timer_fd;
+
+    std::mutex mutex;
+    Timers timers;
+    std::unordered_map<TimerId,Timers::iterator> timers_by_id;
+    TimerId next_id;
+    Clock::time_point armed_deadline;
+};
+
+}
+
+#endif
@@ -0,0 +1,163 @@
+/*
+ * Copyright © 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "tracer.h"
+
+#include <sstream>
+#include <stdexcept>
+
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <boost/throw_exception.hpp>
+
+namespace
+{
+thread_local usc::Tracer::TransitionId current_transition{0};
+
+long current_thread_id()
+{
+    thread_local long const thread_id{syscall(SYS_gettid)};
+    return thread_id;
+}
+}
+
+std::size_t const usc::Tracer::default_capacity{1024};
+
+usc::Tracer::Tracer(std::size_t capacity)
+    : points(capacity),
+      next{0},
+      wrapped{false},
+      last_cause{0},
+      pending_cause_{0}
+{
+    if (capacity == 0)
+        BOOST_THROW_EXCEPTION(std::logic_error("Tracer capacity must be positive"));
+}
+
+void usc::Tracer::trace(char const* point, TransitionId transition)
+{
+    trace(point, transition, 0);
+}
+
+void usc::Tracer::trace(char const* point)
+{
+    trace(point, current_transition, 0);
+}
+
+void usc::Tracer::trace(char const* point, TransitionId transition, CauseId cause)
+{
+    // Take the time before the lock, so that waiting for it doesn't skew
+    // the trace
+    Point const traced{point, transition, cause, Clock::now(), current_thread_id()};
+
+    std::lock_guard<std::mutex> lock{mutex};
+    record(traced);
+}
+
+usc::Tracer::CauseId usc::Tracer::trace_cause(char const* point)
+{
+    auto const time = Clock::now();
+
+    std::lock_guard<std::mutex> lock{mutex};
+
+    pending_cause_ = ++last_cause;
+    record({point, 0, pending_cause_, time, current_thread_id()});
+
+    return pending_cause_;
+}
+
+usc::Tracer::CauseId usc::Tracer::pending_cause() const
+{
+    std::lock_guard<std::mutex> lock{mutex};
+    return pending_cause_;
+}
+
+void usc::Tracer::trace_caused(char const* point, TransitionId transition)
+{
+    auto const time = Clock::now();
+
+    std::lock_guard<std::mutex> lock{mutex};
+
+    record({point, transition, pending_cause_, time, current_thread_id()});
+    pending_cause_ = 0;
+}
+
+void usc::Tracer::record(Point const& point)
+{
+    points[next] = point;
+
+    if (++next == points.size())
+    {
+        next = 0;
+        wrapped = true;
+    }
+}
+
+usc::Tracer::TransitionScope::TransitionScope(TransitionId transition)
+    : previous{current_transition}
+{
+    current_transition = transition;
+}
+
+usc::Tracer::TransitionScope::~TransitionScope()
+{
+    current_transition = previous;
+}
+
+std::string usc::Tracer::chrome_trace_json() const
+{
+    std::vector<Point> recorded;
+
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+
+        if (wrapped)
+            recorded.insert(recorded.end(), points.begin() + next, points.end());
+        recorded.insert(recorded.end(), points.begin(), points.begin() + next);
+    }
+
+    auto const pid = getpid();
+    std::stringstream json;
+
+    json << "{\"traceEvents\":[";
+
+    for (auto iter = recorded.begin(); iter != recorded.end(); ++iter)
+    {
+        auto const timestamp =
+            std::chrono::duration_cast<std::chrono::microseconds>(
+                iter->time.time_since_epoch()).count();
+
+        if (iter != recorded.begin())
+            json << ",";
+
+        json << "{\"name\":\"" << iter->name << "\""
+             << ",\"cat\":\"usc\",\"ph\":\"i\",\"s\":\"t\""
+             << ",\"ts\":" << timestamp
+             << ",\"pid\":" << pid
+             << ",\"tid\":" << iter->thread
+             << ",\"args\":{\"transition\":" << iter->transition;
+
+        if (iter->cause)
+            json << ",\"cause\":" << iter->cause;
+
+        json << "}}";
+    }
+
+    json << "],\"displayTimeUnit\":\"ms\"}";
+
+    return json.str();
+}
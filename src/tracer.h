@@ -0,0 +1,116 @@
+/*
+ * Copyright © 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef USC_TRACER_H_
+#define USC_TRACER_H_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace usc
+{
+
+/*
+ * Records timestamped trace points along the wake-up path (power key,
+ * DBus power requests, display reconfiguration) into a fixed size ring,
+ * overwriting the oldest points once full. Points that belong to a
+ * display power transition carry its id, so that the stages of each
+ * transition can be told apart.
+ *
+ * Points can also be traced as the cause of a transition requested later
+ * (e.g. the power key press that makes powerd turn the screen on). The
+ * cause gets an id of its own, which the first transition traced with
+ * trace_caused() then carries along.
+ *
+ * Point names must be string literals, or otherwise outlive the tracer.
+ */
+class Tracer
+{
+public:
+    using Clock = std::chrono::steady_clock;
+    // 0 for points outside any transition
+    using TransitionId = uint64_t;
+    // 0 for points without a known cause
+    using CauseId = uint64_t;
+
+    static std::size_t const default_capacity;
+
+    explicit Tracer(std::size_t capacity = default_capacity);
+
+    void trace(char const* point, TransitionId transition);
+    // Uses the transition of the innermost TransitionScope on the calling
+    // thread, if any
+    void trace(char const* point);
+    void trace(char const* point, TransitionId transition, CauseId cause);
+
+    // Records a point that may cause a transition, which becomes the
+    // pending cause until a transition takes it
+    CauseId trace_cause(char const* point);
+    // The pending cause, 0 if none
+    CauseId pending_cause() const;
+    // Records a point of transition that takes the pending cause, if any
+    void trace_caused(char const* point, TransitionId transition);
+
+    // Attributes points traced on the current thread to a transition, for
+    // code that doesn't know about transitions (e.g. the Screen)
+    class TransitionScope
+    {
+    public:
+        explicit TransitionScope(TransitionId transition);
+        ~TransitionScope();
+
+    private:
+        TransitionScope(TransitionScope const&) = delete;
+        TransitionScope& operator=(TransitionScope const&) = delete;
+
+        TransitionId const previous;
+    };
+
+    // The recorded points, oldest first, in the Chrome trace event format
+    // (load in chrome://tracing or Perfetto)
+    std::string chrome_trace_json() const;
+
+private:
+    Tracer(Tracer const&) = delete;
+    Tracer& operator=(Tracer const&) = delete;
+
+    struct Point
+    {
+        char const* name;
+        TransitionId transition;
+        CauseId cause;
+        Clock::time_point time;
+        long thread;
+    };
+
+    // Must be called with the mutex held
+    void record(Point const& point);
+
+    mutable std::mutex mutex;
+    std::vector<Point> points;
+    std::size_t next;
+    bool wrapped;
+    CauseId last_cause;
+    CauseId pending_cause_;
+};
+
+}
+
+#endif
@@ -23,7 +23,12 @@
 #include "dbus_connection_handle.h"
 #include "scoped_dbus_error.h"
 
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+
 #include "unity_display_service_introspection.h" // autogenerated
+#include "unity_display_service_methods.h" // autogenerated
 
 namespace
 {
@@ -32,6 +37,48 @@ char const* const dbus_display_interface = "com.canonical.Unity.Display";
 char const* const dbus_display_path = "/com/canonical/Unity/Display";
 char const* const dbus_display_service_name = "com.canonical.Unity.Display";
 
+// Marks the method table entries that count against the caller's rate limit
+bool const rate_limited = true;
+
+// Keys of the replies kept in the reply cache
+enum CachedReply : usc::DBusReplyCache::Key
+{
+    introspect_reply,
+    active_outputs_reply,
+    outputs_reply,
+    all_properties_reply
+};
+
+void append_histogram_json(
+    std::ostream& json, char const* name, usc::Histogram::Snapshot const& histogram)
+{
+    json << "\"" << name << "\":{"
+         << "\"samples\":" << histogram.samples
+         << ",\"p50\":" << histogram.percentile(0.5)
+         << ",\"p99\":" << histogram.percentile(0.99)
+         << ",\"max\":" << histogram.max
+         << "}";
+}
+
+// Percentiles are the upper bounds of the histogram buckets they fall in
+std::string loop_statistics_json(usc::DBusEventLoop const& loop)
+{
+    auto const statistics = loop.statistics();
+    std::stringstream json;
+
+    json << "{";
+    append_histogram_json(json, "action_latency_us", statistics.action_latency);
+    json << ",";
+    append_histogram_json(json, "handler_run_time_us", statistics.handler_run_time);
+    json << ",";
+    append_histogram_json(json, "wake_ups_per_second", statistics.wake_ups_per_second);
+    json << ",\"stalled_iterations\":" << statistics.stalled_iterations
+         << ",\"coalesced_wake_ups\":" << loop.coalesced_wake_ups()
+         << "}";
+
+    return json.str();
+}
+
 void usc_dbus_message_iter_append_active_outputs_variant(
     DBusMessageIter* iter, usc::ActiveOutputs const& active_outputs)
 {
@@ -64,6 +111,66 @@ void usc_dbus_message_iter_append_active_outputs_dict_entry(
     dbus_message_iter_close_container(iter, &iter_entry);
 }
 
+void usc_dbus_message_iter_append_outputs_variant(
+    DBusMessageIter* iter, usc::Outputs const& outputs)
+{
+    DBusMessageIter iter_variant;
+    dbus_message_iter_open_container(iter, DBUS_TYPE_VARIANT, "a(isbb)", &iter_variant);
+
+    DBusMessageIter iter_array;
+    dbus_message_iter_open_container(&iter_variant, DBUS_TYPE_ARRAY, "(isbb)", &iter_array);
+
+    for (auto const& output : outputs)
+    {
+        DBusMessageIter iter_struct;
+        dbus_message_iter_open_container(&iter_array, DBUS_TYPE_STRUCT, nullptr, &iter_struct);
+
+        dbus_int32_t const id{output.id};
+        char const* const type{output.type == usc::OutputType::external ? "external" : "internal"};
+        dbus_bool_t const connected{output.connected};
+        dbus_bool_t const on{output.active()};
+
+        dbus_message_iter_append_basic(&iter_struct, DBUS_TYPE_INT32, &id);
+        dbus_message_iter_append_basic(&iter_struct, DBUS_TYPE_STRING, &type);
+        dbus_message_iter_append_basic(&iter_struct, DBUS_TYPE_BOOLEAN, &connected);
+        dbus_message_iter_append_basic(&iter_struct, DBUS_TYPE_BOOLEAN, &on);
+
+        dbus_message_iter_close_container(&iter_array, &iter_struct);
+    }
+
+    dbus_message_iter_close_container(&iter_variant, &iter_array);
+    dbus_message_iter_close_container(iter, &iter_variant);
+}
+
+void usc_dbus_message_iter_append_outputs_dict_entry(
+    DBusMessageIter* iter, usc::Outputs const& outputs)
+{
+    char const* key = "Outputs";
+    DBusMessageIter iter_entry;
+    dbus_message_iter_open_container(iter, DBUS_TYPE_DICT_ENTRY, nullptr, &iter_entry);
+
+    dbus_message_iter_append_basic(&iter_entry, DBUS_TYPE_STRING, &key);
+    usc_dbus_message_iter_append_outputs_variant(&iter_entry, outputs);
+
+    dbus_message_iter_close_container(iter, &iter_entry);
+}
+
+std::string filter_argument_of(DBusMessage* message)
+{
+    char const* filter{""};
+
+    // For backward compatibility, a missing filter means all outputs
+    if (!dbus_message_get_args(
+            message, nullptr,
+            DBUS_TYPE_STRING, &filter,
+            DBUS_TYPE_INVALID))
+    {
+        filter = "all";
+    }
+
+    return filter;
+}
+
 usc::OutputFilter output_filter_from_string(std::string const& filter_str)
 {
     if (filter_str == "internal")
@@ -76,26 +183,94 @@ usc::OutputFilter output_filter_from_string(std::string const& filter_str)
 
 }
 
+std::chrono::milliseconds const usc::UnityDisplayService::default_active_outputs_window{100};
+unsigned int const usc::UnityDisplayService::max_pending_transitions{16};
+
 usc::UnityDisplayService::UnityDisplayService(
     std::shared_ptr<usc::DBusEventLoop> const& loop,
     std::string const& address,
-    std::shared_ptr<usc::Screen> const& screen)
+    std::shared_ptr<usc::Screen> const& screen,
+    std::shared_ptr<usc::Tracer> const& tracer,
+    std::chrono::milliseconds active_outputs_window)
+    : UnityDisplayService{
+          loop,
+          std::make_shared<DBusConnectionHandle>(address.c_str()),
+          screen,
+          tracer,
+          active_outputs_window}
+{
+}
+
+usc::UnityDisplayService::UnityDisplayService(
+    std::shared_ptr<usc::DBusEventLoop> const& loop,
+    std::shared_ptr<usc::DBusConnectionHandle> const& connection,
+    std::shared_ptr<usc::Screen> const& screen,
+    std::shared_ptr<usc::Tracer> const& tracer,
+    std::chrono::milliseconds active_outputs_window)
     : screen{screen},
+      tracer{tracer},
       loop{loop},
-      connection{std::make_shared<DBusConnectionHandle>(address.c_str())}
+      connection{connection},
+      active_outputs_window{active_outputs_window},
+      method_table{unity_display_service_methods,
+          {{"org.freedesktop.DBus.Introspectable", "Introspect",
+            [this] (DBusMessage* message) { handle_Introspect(message); }},
+           {dbus_display_interface, "TurnOn",
+            [this] (DBusMessage* message) { handle_TurnOn(message); }, rate_limited},
+           {dbus_display_interface, "TurnOff",
+            [this] (DBusMessage* message) { handle_TurnOff(message); }, rate_limited},
+           {dbus_display_interface, "TurnOnOutput",
+            [this] (DBusMessage* message) { handle_TurnOnOutput(message); }, rate_limited},
+           {dbus_display_interface, "TurnOffOutput",
+            [this] (DBusMessage* message) { handle_TurnOffOutput(message); }, rate_limited},
+           {dbus_display_interface, "GetWakeTrace",
+            [this] (DBusMessage* message) { handle_GetWakeTrace(message); }, rate_limited},
+           {dbus_display_interface, "GetLoopStatistics",
+            [this] (DBusMessage* message) { handle_GetLoopStatistics(message); }, rate_limited},
+           {"org.freedesktop.DBus.Properties", "Get",
+            [this] (DBusMessage* message) { handle_properties_Get(message); }},
+           {"org.freedesktop.DBus.Properties", "GetAll",
+            [this] (DBusMessage* message) { handle_properties_GetAll(message); }}}},
+      rate_limiter{RateLimiter::default_burst, RateLimiter::default_calls_per_second},
+      alive{std::make_shared<bool>(true)},
+      display_worker{"USC/Display"}
 {
-    loop->add_connection(connection);
-    connection->request_name(dbus_display_service_name);
-    connection->add_filter(handle_dbus_message_thunk, this);
+    // Requests are only ever added within the limit of pending ones
+    pending_power_requests.reserve(max_pending_transitions);
+    applying_power_requests.reserve(max_pending_transitions);
+
+    // Display power requests are on the wake-up path, so handle them
+    // ahead of other DBus traffic
+    if (connection)
+    {
+        loop->add_connection(connection, DBusEventLoop::Priority::high);
+        connection->request_name(dbus_display_service_name);
+        connection->register_object_path(dbus_display_path, handle_dbus_message_thunk, this);
+    }
 
     screen->register_active_outputs_handler(
         [this] (ActiveOutputs const& active_outputs_arg)
         {
             this->loop->enqueue(
-                [this, active_outputs_arg]
+                DBusEventLoop::Priority::high,
+                [this, weak_alive = std::weak_ptr<void>{alive}, active_outputs_arg]
+                {
+                    auto const live = weak_alive.lock();
+                    if (live)
+                        update_active_outputs(active_outputs_arg);
+                });
+        });
+
+    screen->register_outputs_handler(
+        [this] (Outputs const& outputs_arg)
+        {
+            this->loop->enqueue(
+                DBusEventLoop::Priority::high,
+                [this, weak_alive = std::weak_ptr<void>{alive}, new_outputs = Outputs{outputs_arg}]
                 {
-                    active_outputs = active_outputs_arg;
-                    dbus_emit_ActiveOutputs();
+                    auto const live = weak_alive.lock();
+                    if (live)
+                        update_outputs(new_outputs);
                 });
         });
 }
@@ -103,6 +278,42 @@ usc::UnityDisplayService::UnityDisplayService(
 usc::UnityDisplayService::~UnityDisplayService()
 {
     screen->register_active_outputs_handler([](ActiveOutputs const&){});
+    screen->register_outputs_handler([](Outputs const&){});
+    if (connection)
+        connection->unregister_object_path(dbus_display_path);
+    for (auto const& peer : peer_connections)
+        peer->unregister_object_path(dbus_display_path);
+
+    // Transitions that were already requested are carried out, and queue
+    // their completions on the loop
+    display_worker.finish();
+
+    // Nothing queues more work for the loop now, but it may be running
+    // some of ours, or about to. Let that finish before our members go,
+    // then once more for a deferred emission that starts before it can
+    // be cancelled.
+    loop->drain(DBusEventLoop::Priority::high);
+    loop->cancel(properties_changed_emission);
+    loop->drain(DBusEventLoop::Priority::high);
+}
+
+void usc::UnityDisplayService::add_peer_connection(
+    std::shared_ptr<DBusConnectionHandle> const& peer)
+{
+    peer->register_object_path(dbus_display_path, handle_dbus_message_thunk, this);
+    peer_connections.push_back(peer);
+}
+
+void usc::UnityDisplayService::remove_peer_connection(
+    std::shared_ptr<DBusConnectionHandle> const& peer)
+{
+    auto const iter = std::find(begin(peer_connections), end(peer_connections), peer);
+    if (iter == end(peer_connections))
+        return;
+
+    peer->unregister_object_path(dbus_display_path);
+    peer_connections.erase(iter);
+    rate_limiter.forget_peer(*peer);
 }
 
 ::DBusHandlerResult usc::UnityDisplayService::handle_dbus_message_thunk(
@@ -115,114 +326,453 @@ usc::UnityDisplayService::~UnityDisplayService()
 DBusHandlerResult usc::UnityDisplayService::handle_dbus_message(
     ::DBusConnection* connection, DBusMessage* message, void* user_data)
 {
-    ScopedDBusError args_error;
+    if (auto const method = method_table.find(message))
+    {
+        calling_connection = connection;
 
-    if (dbus_message_is_method_call(message, "org.freedesktop.DBus.Introspectable", "Introspect"))
+        // Calls to the standard interfaces are answered from the reply
+        // cache, only our own methods can make us do real work
+        if (method->rate_limited &&
+            !rate_limiter.admit(connection, message))
+        {
+            send_limits_exceeded_error(message, "Too many requests");
+        }
+        else
+        {
+            method->handler(message);
+        }
+    }
+    else if (dbus_message_get_type(message) == DBUS_MESSAGE_TYPE_METHOD_CALL)
     {
-        DBusMessageHandle reply{
-            dbus_message_new_method_return(message),
-            DBUS_TYPE_STRING, &unity_display_service_introspection,
-            DBUS_TYPE_INVALID};
+         DBusMessageHandle reply{
+             dbus_message_new_error(message, DBUS_ERROR_FAILED, "Not supported")};
 
         dbus_connection_send(connection, reply, nullptr);
     }
-    else if (dbus_message_is_method_call(message, dbus_display_interface, "TurnOn"))
+
+    return DBUS_HANDLER_RESULT_HANDLED;
+}
+
+void usc::UnityDisplayService::handle_Introspect(DBusMessage* message)
+{
+    auto const reply = reply_cache.reply_to(
+        message, introspect_reply,
+        [] (DBusMessage* reply)
+        {
+            dbus_message_append_args(
+                reply,
+                DBUS_TYPE_STRING, &unity_display_service_introspection,
+                DBUS_TYPE_INVALID);
+        });
+
+    dbus_connection_send(calling_connection, reply, nullptr);
+}
+
+void usc::UnityDisplayService::handle_TurnOn(DBusMessage* message)
+{
+    send_transition_reply(message, dbus_TurnOn(filter_argument_of(message)));
+}
+
+void usc::UnityDisplayService::handle_TurnOff(DBusMessage* message)
+{
+    send_transition_reply(message, dbus_TurnOff(filter_argument_of(message)));
+}
+
+void usc::UnityDisplayService::handle_TurnOnOutput(DBusMessage* message)
+{
+    dbus_int32_t id{-1};
+    if (!dbus_message_get_args(message, nullptr, DBUS_TYPE_INT32, &id, DBUS_TYPE_INVALID))
     {
-        char const* filter{""};
-        dbus_message_get_args(
-            message, &args_error,
-            DBUS_TYPE_STRING, &filter,
-            DBUS_TYPE_INVALID);
+        send_invalid_arguments_error(message);
+        return;
+    }
 
-        // For backward compatibility
-        if (args_error)
-            filter = "all";
+    if (!is_known_output(id))
+    {
+        send_unknown_output_error(message);
+        return;
+    }
 
-        dbus_TurnOn(filter);
+    send_transition_reply(message, dbus_TurnOnOutput(id));
+}
 
-        DBusMessageHandle reply{dbus_message_new_method_return(message)};
-        dbus_connection_send(connection, reply, nullptr);
+void usc::UnityDisplayService::handle_TurnOffOutput(DBusMessage* message)
+{
+    dbus_int32_t id{-1};
+    if (!dbus_message_get_args(message, nullptr, DBUS_TYPE_INT32, &id, DBUS_TYPE_INVALID))
+    {
+        send_invalid_arguments_error(message);
+        return;
     }
-    else if (dbus_message_is_method_call(message, dbus_display_interface, "TurnOff"))
+
+    if (!is_known_output(id))
     {
-        char const* filter{""};
+        send_unknown_output_error(message);
+        return;
+    }
 
-        dbus_message_get_args(
-            message, &args_error,
-            DBUS_TYPE_STRING, &filter,
-            DBUS_TYPE_INVALID);
+    send_transition_reply(message, dbus_TurnOffOutput(id));
+}
 
-        // For backward compatibility
-        if (args_error)
-            filter = "all";
+void usc::UnityDisplayService::handle_GetWakeTrace(DBusMessage* message)
+{
+    auto const trace = tracer->chrome_trace_json();
+    auto const trace_cstr = trace.c_str();
 
-        dbus_TurnOff(filter);
+    DBusMessageHandle reply{dbus_message_new_method_return(message)};
+    dbus_message_append_args(
+        reply,
+        DBUS_TYPE_STRING, &trace_cstr,
+        DBUS_TYPE_INVALID);
 
-        DBusMessageHandle reply{dbus_message_new_method_return(message)};
-        dbus_connection_send(connection, reply, nullptr);
+    dbus_connection_send(calling_connection, reply, nullptr);
+}
+
+void usc::UnityDisplayService::handle_GetLoopStatistics(DBusMessage* message)
+{
+    auto const statistics = loop_statistics_json(*loop);
+    auto const statistics_cstr = statistics.c_str();
+
+    DBusMessageHandle reply{dbus_message_new_method_return(message)};
+    dbus_message_append_args(
+        reply,
+        DBUS_TYPE_STRING, &statistics_cstr,
+        DBUS_TYPE_INVALID);
+
+    dbus_connection_send(calling_connection, reply, nullptr);
+}
+
+void usc::UnityDisplayService::handle_properties_Get(DBusMessage* message)
+{
+    ScopedDBusError args_error;
+    char const* interface{""};
+    char const* property{""};
+    dbus_message_get_args(
+        message, &args_error,
+        DBUS_TYPE_STRING, &interface,
+        DBUS_TYPE_STRING, &property,
+        DBUS_TYPE_INVALID);
+
+    if (args_error)
+    {
+        send_invalid_arguments_error(message);
+        return;
     }
-    else if (dbus_message_is_method_call(message, "org.freedesktop.DBus.Properties", "Get"))
+
+    if (strcmp(interface, dbus_display_interface) == 0 &&
+        strcmp(property, "ActiveOutputs") == 0)
     {
-        char const* interface{""};
-        char const* property{""};
-        dbus_message_get_args(
-            message, &args_error,
-            DBUS_TYPE_STRING, &interface,
-            DBUS_TYPE_STRING, &property,
-            DBUS_TYPE_INVALID);
+        auto const reply = reply_cache.reply_to(
+            message, active_outputs_reply,
+            [this] (DBusMessage* reply) { dbus_properties_Get(reply, "ActiveOutputs"); });
 
-        DBusMessageHandle reply{dbus_message_new_method_return(message)};
+        dbus_connection_send(calling_connection, reply, nullptr);
+        return;
+    }
 
-        if (!args_error && std::string{interface} == dbus_display_interface)
-            dbus_properties_Get(reply, property);
+    if (strcmp(interface, dbus_display_interface) == 0 &&
+        strcmp(property, "Outputs") == 0)
+    {
+        auto const reply = reply_cache.reply_to(
+            message, outputs_reply,
+            [this] (DBusMessage* reply) { dbus_properties_Get(reply, "Outputs"); });
 
-        dbus_connection_send(connection, reply, nullptr);
+        dbus_connection_send(calling_connection, reply, nullptr);
+        return;
+    }
+
+    DBusMessageHandle reply{dbus_message_new_method_return(message)};
+    dbus_connection_send(calling_connection, reply, nullptr);
+}
+
+void usc::UnityDisplayService::handle_properties_GetAll(DBusMessage* message)
+{
+    ScopedDBusError args_error;
+    char const* interface{""};
+    dbus_message_get_args(
+        message, &args_error,
+        DBUS_TYPE_STRING, &interface,
+        DBUS_TYPE_INVALID);
+
+    if (args_error)
+    {
+        send_invalid_arguments_error(message);
+        return;
     }
-    else if (dbus_message_is_method_call(message, "org.freedesktop.DBus.Properties", "GetAll"))
+
+    if (strcmp(interface, dbus_display_interface) == 0)
     {
-        char const* interface{""};
-        dbus_message_get_args(
-            message, &args_error,
-            DBUS_TYPE_STRING, &interface,
-            DBUS_TYPE_INVALID);
+        auto const reply = reply_cache.reply_to(
+            message, all_properties_reply,
+            [this] (DBusMessage* reply) { dbus_properties_GetAll(reply); });
 
-        DBusMessageHandle reply{dbus_message_new_method_return(message)};
+        dbus_connection_send(calling_connection, reply, nullptr);
+        return;
+    }
 
-        if (!args_error && std::string{interface} == dbus_display_interface)
-            dbus_properties_GetAll(reply);
+    DBusMessageHandle reply{dbus_message_new_method_return(message)};
+    dbus_connection_send(calling_connection, reply, nullptr);
+}
 
-        dbus_connection_send(connection, reply, nullptr);
+void usc::UnityDisplayService::send_invalid_arguments_error(DBusMessage* message)
+{
+    DBusMessageHandle reply{
+        dbus_message_new_error(message, DBUS_ERROR_INVALID_ARGS, "Invalid arguments")};
+
+    dbus_connection_send(calling_connection, reply, nullptr);
+}
+
+void usc::UnityDisplayService::send_transition_reply(
+    DBusMessage* message, TransitionId transition)
+{
+    if (transition == no_transition)
+    {
+        send_limits_exceeded_error(message, "Too many pending power changes");
+        return;
     }
-    else if (dbus_message_get_type(message) == DBUS_MESSAGE_TYPE_METHOD_CALL)
+
+    DBusMessageHandle reply{dbus_message_new_method_return(message)};
+    dbus_uint64_t const transition_arg{transition};
+    dbus_message_append_args(
+        reply,
+        DBUS_TYPE_UINT64, &transition_arg,
+        DBUS_TYPE_INVALID);
+
+    dbus_connection_send(calling_connection, reply, nullptr);
+}
+
+void usc::UnityDisplayService::send_limits_exceeded_error(
+    DBusMessage* message, char const* reason)
+{
+    DBusMessageHandle reply{
+        dbus_message_new_error(message, DBUS_ERROR_LIMITS_EXCEEDED, reason)};
+
+    dbus_connection_send(calling_connection, reply, nullptr);
+}
+
+void usc::UnityDisplayService::send_unknown_output_error(DBusMessage* message)
+{
+    DBusMessageHandle reply{
+        dbus_message_new_error(message, DBUS_ERROR_FAILED, "Unknown output")};
+
+    dbus_connection_send(calling_connection, reply, nullptr);
+}
+
+bool usc::UnityDisplayService::is_known_output(OutputId id) const
+{
+    return std::any_of(begin(outputs), end(outputs),
+        [id] (Output const& output) { return output.id == id; });
+}
+
+usc::UnityDisplayService::TransitionId usc::UnityDisplayService::dbus_TurnOn(
+    std::string const& filter)
+{
+    return request_power_transition({true, output_filter_from_string(filter), -1});
+}
+
+usc::UnityDisplayService::TransitionId usc::UnityDisplayService::dbus_TurnOff(
+    std::string const& filter)
+{
+    return request_power_transition({false, output_filter_from_string(filter), -1});
+}
+
+usc::UnityDisplayService::TransitionId usc::UnityDisplayService::dbus_TurnOnOutput(
+    OutputId id)
+{
+    return request_power_transition({true, OutputFilter::all, id});
+}
+
+usc::UnityDisplayService::TransitionId usc::UnityDisplayService::dbus_TurnOffOutput(
+    OutputId id)
+{
+    return request_power_transition({false, OutputFilter::all, id});
+}
+
+// Power changes block until the displays have been reconfigured, so they
+// run on the display worker, in request order, and the DBus thread only
+// hands out the transition ids
+usc::UnityDisplayService::TransitionId usc::UnityDisplayService::request_power_transition(
+    PowerRequest const& request)
+{
+    bool const transition_in_progress{last_transition != completed_transition};
+
+    // Repeating the latest request while it's in progress changes nothing,
+    // so the caller can just wait for the same transition
+    if (transition_in_progress && request == last_request)
     {
-         DBusMessageHandle reply{
-             dbus_message_new_error(message, DBUS_ERROR_FAILED, "Not supported")};
+        tracer->trace_caused("power_request_merged", last_transition);
+        return last_transition;
+    }
 
-        dbus_connection_send(connection, reply, nullptr);
+    if (last_transition - completed_transition >= max_pending_transitions)
+        return no_transition;
+
+    auto const transition = ++last_transition;
+    last_request = request;
+
+    tracer->trace_caused(request.on ? "turn_on_requested" : "turn_off_requested", transition);
+
+    bool worker_needed{false};
+
+    {
+        std::lock_guard<std::mutex> lock{pending_power_requests_mutex};
+
+        // The outputs of a superseded request end up in the state we ask
+        // for, which is what its transition reports once complete
+        for (auto& pending : pending_power_requests)
+        {
+            if (request.supersedes(pending.request))
+            {
+                if (!pending.superseded)
+                    tracer->trace("power_request_superseded", pending.transition);
+
+                pending.superseded = true;
+                pending.request.on = request.on;
+            }
+        }
+
+        // Otherwise the worker has yet to take the requests already there
+        worker_needed = pending_power_requests.empty();
+        pending_power_requests.push_back({request, transition, false});
     }
 
-    if (args_error)
+    if (worker_needed)
+        display_worker.queue([this] { apply_pending_power_requests(); });
+
+    return transition;
+}
+
+void usc::UnityDisplayService::apply_pending_power_requests()
+{
     {
-         DBusMessageHandle reply{
-             dbus_message_new_error(message, DBUS_ERROR_FAILED, "Invalid arguments")};
+        std::lock_guard<std::mutex> lock{pending_power_requests_mutex};
+        applying_power_requests.swap(pending_power_requests);
+    }
 
-        dbus_connection_send(connection, reply, nullptr);
+    for (auto const& pending : applying_power_requests)
+    {
+        if (pending.superseded)
+            continue;
+
+        Tracer::TransitionScope const scope{pending.transition};
+
+        tracer->trace("power_transition_started");
+        apply_power_request(pending.request);
+        tracer->trace("power_transition_completed");
     }
 
-    return DBUS_HANDLER_RESULT_HANDLED;
+    // Still in request order, superseded transitions included
+    for (auto const& pending : applying_power_requests)
+        complete_power_transition(pending.transition, pending.request.on);
+
+    applying_power_requests.clear();
+}
+
+void usc::UnityDisplayService::apply_power_request(PowerRequest const& request)
+{
+    if (request.output >= 0)
+    {
+        if (request.on)
+            screen->turn_on_output(request.output);
+        else
+            screen->turn_off_output(request.output);
+    }
+    else
+    {
+        if (request.on)
+            screen->turn_on(request.filter);
+        else
+            screen->turn_off(request.filter);
+    }
 }
 
-void usc::UnityDisplayService::dbus_TurnOn(std::string const& filter)
+void usc::UnityDisplayService::complete_power_transition(
+    TransitionId transition, bool on)
 {
-    screen->turn_on(output_filter_from_string(filter));
+    loop->enqueue(
+        DBusEventLoop::Priority::high,
+        [this, weak_alive = std::weak_ptr<void>{alive}, transition, on]
+        {
+            auto const live = weak_alive.lock();
+            if (!live)
+                return;
+
+            completed_transition = transition;
+            dbus_emit_PowerStateChanged(transition, on);
+            tracer->trace("power_state_changed_sent", transition);
+        });
 }
 
-void usc::UnityDisplayService::dbus_TurnOff(std::string const& filter)
+void usc::UnityDisplayService::update_active_outputs(ActiveOutputs const& new_active_outputs)
 {
-    screen->turn_off(output_filter_from_string(filter));
+    // Get/GetAll always see the latest value, only the signal is deferred
+    if (!(new_active_outputs == active_outputs))
+    {
+        active_outputs = new_active_outputs;
+        reply_cache.invalidate(active_outputs_reply);
+        reply_cache.invalidate(all_properties_reply);
+    }
+
+    schedule_properties_changed();
 }
 
-void usc::UnityDisplayService::dbus_emit_ActiveOutputs()
+void usc::UnityDisplayService::update_outputs(Outputs const& new_outputs)
+{
+    if (!(new_outputs == outputs))
+    {
+        outputs = new_outputs;
+        reply_cache.invalidate(outputs_reply);
+        reply_cache.invalidate(all_properties_reply);
+    }
+
+    schedule_properties_changed();
+}
+
+void usc::UnityDisplayService::schedule_properties_changed()
+{
+    if (properties_changed_pending ||
+        (active_outputs == emitted_active_outputs && outputs == emitted_outputs))
+    {
+        return;
+    }
+
+    auto const next_emission = last_properties_changed + active_outputs_window;
+
+    if (TimerQueue::Clock::now() >= next_emission)
+    {
+        emit_changed_properties();
+    }
+    else
+    {
+        properties_changed_pending = true;
+        properties_changed_emission = loop->enqueue_at(
+            next_emission,
+            [this]
+            {
+                properties_changed_pending = false;
+                emit_changed_properties();
+            });
+    }
+}
+
+void usc::UnityDisplayService::emit_changed_properties()
+{
+    // The properties may have reverted to the last emitted state while
+    // the signal was deferred, in which case there is nothing to tell
+    bool const active_outputs_changed{!(active_outputs == emitted_active_outputs)};
+    bool const outputs_changed{!(outputs == emitted_outputs)};
+
+    if (!active_outputs_changed && !outputs_changed)
+        return;
+
+    emitted_active_outputs = active_outputs;
+    emitted_outputs = outputs;
+    last_properties_changed = TimerQueue::Clock::now();
+    dbus_emit_PropertiesChanged(active_outputs_changed, outputs_changed);
+}
+
+void usc::UnityDisplayService::dbus_emit_PropertiesChanged(
+    bool active_outputs_changed, bool outputs_changed)
 {
     DBusMessageHandle signal{
         dbus_message_new_signal(
@@ -239,7 +789,10 @@ void usc::UnityDisplayService::dbus_emit_ActiveOutputs()
         DBusMessageIter iter_dict;
         dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY, "{sv}", &iter_dict);
 
-        usc_dbus_message_iter_append_active_outputs_dict_entry(&iter_dict, active_outputs);
+        if (active_outputs_changed)
+            usc_dbus_message_iter_append_active_outputs_dict_entry(&iter_dict, active_outputs);
+        if (outputs_changed)
+            usc_dbus_message_iter_append_outputs_dict_entry(&iter_dict, outputs);
 
         dbus_message_iter_close_container(&iter, &iter_dict);
     }
@@ -250,8 +803,42 @@ void usc::UnityDisplayService::dbus_emit_ActiveOutputs()
         dbus_message_iter_close_container(&iter, &iter_array);
     }
 
-    dbus_connection_send(*connection, signal, nullptr);
-    dbus_connection_flush(*connection);
+    send_signal(signal);
+}
+
+void usc::UnityDisplayService::dbus_emit_PowerStateChanged(
+    TransitionId transition, bool on)
+{
+    DBusMessageHandle signal{
+        dbus_message_new_signal(
+            dbus_display_path,
+            dbus_display_interface,
+            "PowerStateChanged")};
+
+    dbus_uint64_t const transition_arg{transition};
+    dbus_bool_t const on_arg{on};
+    dbus_message_append_args(
+        signal,
+        DBUS_TYPE_UINT64, &transition_arg,
+        DBUS_TYPE_BOOLEAN, &on_arg,
+        DBUS_TYPE_INVALID);
+
+    send_signal(signal);
+}
+
+void usc::UnityDisplayService::send_signal(DBusMessage* signal)
+{
+    // Each connection assigns its own serial, so peers get a copy each,
+    // taken before sending sets the serial of the original
+    for (auto const& peer : peer_connections)
+    {
+        DBusMessageHandle peer_signal{dbus_message_copy(signal)};
+        dbus_connection_send(*peer, peer_signal, nullptr);
+    }
+
+    // The loop flushes the connections once it is done dispatching
+    if (connection)
+        dbus_connection_send(*connection, signal, nullptr);
 }
 
 void usc::UnityDisplayService::dbus_properties_Get(DBusMessage* reply, std::string const& property)
@@ -261,6 +848,8 @@ void usc::UnityDisplayService::dbus_properties_Get(DBusMessage* reply, std::stri
 
     if (property == "ActiveOutputs")
         usc_dbus_message_iter_append_active_outputs_variant(&iter, active_outputs);
+    else if (property == "Outputs")
+        usc_dbus_message_iter_append_outputs_variant(&iter, outputs);
 }
 
 void usc::UnityDisplayService::dbus_properties_GetAll(DBusMessage* reply)
@@ -273,6 +862,7 @@ void usc::UnityDisplayService::dbus_properties_GetAll(DBusMessage* reply)
         dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY, "{sv}", &iter_dict);
 
         usc_dbus_message_iter_append_active_outputs_dict_entry(&iter_dict, active_outputs);
+        usc_dbus_message_iter_append_outputs_dict_entry(&iter_dict, outputs);
 
         dbus_message_iter_close_container(&iter, &iter_dict);
     }
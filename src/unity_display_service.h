@@ -20,41 +20,171 @@
 #define USC_UNITY_DISPLAY_SERVICE_H_
 
 #include "dbus_connection_handle.h"
+#include "dbus_event_loop.h"
+#include "dbus_method_table.h"
+#include "dbus_reply_cache.h"
+#include "rate_limiter.h"
 #include "screen.h"
+#include "tracer.h"
+#include "worker_thread.h"
 
+#include <chrono>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <vector>
 
 namespace usc
 {
 class Screen;
-class DBusEventLoop;
 
 class UnityDisplayService
 {
 public:
+    // Identifies a power change requested over DBus in the matching
+    // PowerStateChanged signal, and in the wake-up trace
+    using TransitionId = Tracer::TransitionId;
+
+    // Power changes requested while this many are still in progress are
+    // rejected with a LimitsExceeded error
+    static unsigned int const max_pending_transitions;
+
+    // Property changes arriving within this window of the last
+    // PropertiesChanged signal are folded into a single, later signal
+    static std::chrono::milliseconds const default_active_outputs_window;
+
     UnityDisplayService(
         std::shared_ptr<usc::DBusEventLoop> const& loop,
         std::string const& address,
-        std::shared_ptr<usc::Screen> const& screen);
+        std::shared_ptr<usc::Screen> const& screen,
+        std::shared_ptr<usc::Tracer> const& tracer,
+        std::chrono::milliseconds active_outputs_window = default_active_outputs_window);
+    // A null connection exposes the service on peer connections only
+    UnityDisplayService(
+        std::shared_ptr<usc::DBusEventLoop> const& loop,
+        std::shared_ptr<usc::DBusConnectionHandle> const& connection,
+        std::shared_ptr<usc::Screen> const& screen,
+        std::shared_ptr<usc::Tracer> const& tracer,
+        std::chrono::milliseconds active_outputs_window = default_active_outputs_window);
     ~UnityDisplayService();
 
+    // Exposes the service on a peer-to-peer connection, which needs no
+    // bus name. Must be called on the loop thread.
+    void add_peer_connection(std::shared_ptr<DBusConnectionHandle> const& peer);
+    void remove_peer_connection(std::shared_ptr<DBusConnectionHandle> const& peer);
+
 private:
     static ::DBusHandlerResult handle_dbus_message_thunk(
         DBusConnection* connection, DBusMessage* message, void* user_data);
     ::DBusHandlerResult handle_dbus_message(
         DBusConnection* connection, DBusMessage* message, void* user_data);
 
-    void dbus_TurnOn(std::string const& filter);
-    void dbus_TurnOff(std::string const& filter);
-    void dbus_emit_ActiveOutputs();
+    void handle_Introspect(DBusMessage* message);
+    void handle_TurnOn(DBusMessage* message);
+    void handle_TurnOff(DBusMessage* message);
+    void handle_TurnOnOutput(DBusMessage* message);
+    void handle_TurnOffOutput(DBusMessage* message);
+    void handle_GetWakeTrace(DBusMessage* message);
+    void handle_GetLoopStatistics(DBusMessage* message);
+    void handle_properties_Get(DBusMessage* message);
+    void handle_properties_GetAll(DBusMessage* message);
+    void send_invalid_arguments_error(DBusMessage* message);
+    void send_unknown_output_error(DBusMessage* message);
+    bool is_known_output(OutputId id) const;
+
+    void send_transition_reply(DBusMessage* message, TransitionId transition);
+    void send_limits_exceeded_error(DBusMessage* message, char const* reason);
+
+    // A power change, either for the outputs matching a filter, or for a
+    // single output
+    struct PowerRequest
+    {
+        bool on;
+        OutputFilter filter;
+        // -1 for requests by filter
+        OutputId output;
+
+        bool operator==(PowerRequest const& other) const
+        {
+            return on == other.on && filter == other.filter && output == other.output;
+        }
+
+        // Whether applying this request leaves nothing for other to do
+        bool supersedes(PowerRequest const& other) const
+        {
+            return (output < 0 && filter == OutputFilter::all) ||
+                   (filter == other.filter && output == other.output);
+        }
+    };
+
+    // A power request waiting for the display worker. A later request
+    // for the same outputs takes over a waiting one, which is then not
+    // applied but completes along with the request that took over.
+    struct PendingPowerRequest
+    {
+        PowerRequest request;
+        TransitionId transition;
+        bool superseded;
+    };
+
+    // Power requests return the id of their transition, or
+    // no_transition if too many transitions are in progress
+    static TransitionId const no_transition{0};
+    TransitionId dbus_TurnOn(std::string const& filter);
+    TransitionId dbus_TurnOff(std::string const& filter);
+    TransitionId dbus_TurnOnOutput(OutputId id);
+    TransitionId dbus_TurnOffOutput(OutputId id);
+    TransitionId request_power_transition(PowerRequest const& request);
+    void apply_pending_power_requests();
+    void apply_power_request(PowerRequest const& request);
+    void complete_power_transition(TransitionId transition, bool on);
+    void update_active_outputs(ActiveOutputs const& new_active_outputs);
+    void update_outputs(Outputs const& new_outputs);
+    void schedule_properties_changed();
+    void emit_changed_properties();
+    void dbus_emit_PropertiesChanged(bool active_outputs_changed, bool outputs_changed);
+    void dbus_emit_PowerStateChanged(TransitionId transition, bool on);
+    void send_signal(DBusMessage* signal);
     void dbus_properties_Get(DBusMessage* reply, std::string const& property);
     void dbus_properties_GetAll(DBusMessage* reply);
 
     std::shared_ptr<usc::Screen> const screen;
+    std::shared_ptr<usc::Tracer> const tracer;
     std::shared_ptr<DBusEventLoop> const loop;
     std::shared_ptr<DBusConnectionHandle> connection;
+    std::vector<std::shared_ptr<DBusConnectionHandle>> peer_connections;
+    // The connection the message being handled arrived on
+    ::DBusConnection* calling_connection{nullptr};
+    std::chrono::milliseconds const active_outputs_window;
+    // Only accessed from the loop thread
     ActiveOutputs active_outputs;
+    ActiveOutputs emitted_active_outputs;
+    Outputs outputs;
+    Outputs emitted_outputs;
+    TimerQueue::Clock::time_point last_properties_changed;
+    bool properties_changed_pending{false};
+    DBusEventLoop::DelayedActionId properties_changed_emission{0};
+    DBusMethodTable const method_table;
+    DBusReplyCache reply_cache;
+    RateLimiter rate_limiter;
+    // Transitions complete in request order, so the ones in between
+    // these two are still in progress
+    TransitionId last_transition{0};
+    TransitionId completed_transition{0};
+    PowerRequest last_request{};
+    // Requests the display worker has yet to take. It takes them all at
+    // once, so that requests arriving while the screen is busy collapse.
+    std::mutex pending_power_requests_mutex;
+    std::vector<PendingPowerRequest> pending_power_requests;
+    // Only accessed from the display worker
+    std::vector<PendingPowerRequest> applying_power_requests;
+    // Actions queued on the loop only hold a weak reference to this, so
+    // that those left queued when the service is destroyed while the
+    // loop isn't running are dropped. Otherwise the destructor waits
+    // for the loop to get through them.
+    std::shared_ptr<void> const alive;
+    // Finished on destruction, once no more transitions can be requested
+    WorkerThread display_worker;
 };
 
 }
@@ -20,9 +20,14 @@
 #include "input_configuration.h"
 #include "dbus_message_handle.h"
 #include "dbus_event_loop.h"
-#include "scoped_dbus_error.h"
 
 #include "unity_input_service_introspection.h" // autogenerated
+#include "unity_input_service_methods.h" // autogenerated
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <string>
 
 namespace
 {
@@ -31,16 +36,205 @@ char const* const dbus_input_interface = "com.canonical.Unity.Input";
 char const* const dbus_input_path = "/com/canonical/Unity/Input";
 char const* const dbus_input_service_name = "com.canonical.Unity.Input";
 
+// Marks the method table entries that count against the caller's rate limit
+bool const rate_limited = true;
+
+// Key of the only reply kept in the reply cache
+usc::DBusReplyCache::Key const introspect_reply = 0;
+
+// Maps the argument types of InputConfiguration setters to DBus types
+template <typename T> struct DBusArgument;
+
+template <> struct DBusArgument<bool>
+{
+    static int const type = DBUS_TYPE_BOOLEAN;
+    using Storage = dbus_bool_t;
+};
+
+template <> struct DBusArgument<int32_t>
+{
+    static int const type = DBUS_TYPE_INT32;
+    using Storage = int32_t;
+};
+
+template <> struct DBusArgument<double>
+{
+    static int const type = DBUS_TYPE_DOUBLE;
+    using Storage = double;
+};
+
+// Exactly one of the members is set, depending on the type of the setting
+struct Setting
+{
+    char const* key;
+    int32_t usc::InputSettings::* int32_member;
+    double usc::InputSettings::* double_member;
+    bool usc::InputSettings::* bool_member;
+
+    int dbus_type() const
+    {
+        return int32_member ? DBUS_TYPE_INT32 :
+               double_member ? DBUS_TYPE_DOUBLE :
+               DBUS_TYPE_BOOLEAN;
+    }
+};
+
+Setting const settings_by_key[] = {
+    {"MousePrimaryButton", &usc::InputSettings::mouse_primary_button, nullptr, nullptr},
+    {"MouseCursorSpeed", nullptr, &usc::InputSettings::mouse_cursor_speed, nullptr},
+    {"MouseScrollSpeed", nullptr, &usc::InputSettings::mouse_scroll_speed, nullptr},
+    {"TouchpadPrimaryButton", &usc::InputSettings::touchpad_primary_button, nullptr, nullptr},
+    {"TouchpadCursorSpeed", nullptr, &usc::InputSettings::touchpad_cursor_speed, nullptr},
+    {"TouchpadScrollSpeed", nullptr, &usc::InputSettings::touchpad_scroll_speed, nullptr},
+    {"TouchpadDisableWhileTyping", nullptr, nullptr, &usc::InputSettings::disable_touchpad_while_typing},
+    {"TouchpadTapToClick", nullptr, nullptr, &usc::InputSettings::tap_to_click},
+    {"TouchpadTwoFingerScroll", nullptr, nullptr, &usc::InputSettings::two_finger_scroll},
+    {"TouchpadDisableWithMouse", nullptr, nullptr, &usc::InputSettings::disable_touchpad_with_mouse},
+};
+
+Setting const* setting_for(char const* key)
+{
+    for (auto const& setting : settings_by_key)
+    {
+        if (strcmp(setting.key, key) == 0)
+            return &setting;
+    }
+
+    return nullptr;
+}
+
+// Returns false if the value is not acceptable for the setting
+bool read_setting(DBusMessageIter* iter, Setting const& setting, usc::InputSettings& settings)
+{
+    if (dbus_message_iter_get_arg_type(iter) != setting.dbus_type())
+        return false;
+
+    if (setting.int32_member)
+    {
+        dbus_message_iter_get_basic(iter, &(settings.*setting.int32_member));
+    }
+    else if (setting.double_member)
+    {
+        double value{0.0};
+        dbus_message_iter_get_basic(iter, &value);
+        if (!std::isfinite(value))
+            return false;
+        settings.*setting.double_member = value;
+    }
+    else
+    {
+        dbus_bool_t value{FALSE};
+        dbus_message_iter_get_basic(iter, &value);
+        settings.*setting.bool_member = value;
+    }
+
+    return true;
+}
+
+void append_setting(DBusMessageIter* iter, Setting const& setting, usc::InputSettings const& settings)
+{
+    char const signature[] = {static_cast<char>(setting.dbus_type()), '\0'};
+
+    DBusMessageIter iter_entry;
+    dbus_message_iter_open_container(iter, DBUS_TYPE_DICT_ENTRY, nullptr, &iter_entry);
+    dbus_message_iter_append_basic(&iter_entry, DBUS_TYPE_STRING, &setting.key);
+
+    DBusMessageIter iter_variant;
+    dbus_message_iter_open_container(&iter_entry, DBUS_TYPE_VARIANT, signature, &iter_variant);
+
+    if (setting.int32_member)
+    {
+        dbus_message_iter_append_basic(&iter_variant, DBUS_TYPE_INT32, &(settings.*setting.int32_member));
+    }
+    else if (setting.double_member)
+    {
+        dbus_message_iter_append_basic(&iter_variant, DBUS_TYPE_DOUBLE, &(settings.*setting.double_member));
+    }
+    else
+    {
+        dbus_bool_t const value = settings.*setting.bool_member;
+        dbus_message_iter_append_basic(&iter_variant, DBUS_TYPE_BOOLEAN, &value);
+    }
+
+    dbus_message_iter_close_container(&iter_entry, &iter_variant);
+    dbus_message_iter_close_container(iter, &iter_entry);
+}
+
 }
 
 usc::UnityInputService::UnityInputService(std::shared_ptr<usc::DBusEventLoop> const& loop,
                                           std::string const& address,
                                           std::shared_ptr<usc::InputConfiguration> const& input_config)
-    : loop{loop}, connection{std::make_shared<DBusConnectionHandle>(address.c_str())}, input_config{input_config}
+    : UnityInputService{loop, std::make_shared<DBusConnectionHandle>(address.c_str()), input_config}
 {
-    loop->add_connection(connection);
-    connection->request_name(dbus_input_service_name);
-    connection->add_filter(handle_dbus_message_thunk, this);
+}
+
+usc::UnityInputService::UnityInputService(std::shared_ptr<usc::DBusEventLoop> const& loop,
+                                          std::shared_ptr<usc::DBusConnectionHandle> const& connection,
+                                          std::shared_ptr<usc::InputConfiguration> const& input_config)
+    : loop{loop}, connection{connection}, input_config{input_config},
+      method_table{unity_input_service_methods,
+          {{"org.freedesktop.DBus.Introspectable", "Introspect",
+            [this] (DBusMessage* message) { handle_Introspect(message); }},
+           {dbus_input_interface, "setMousePrimaryButton",
+            setter(&InputConfiguration::set_mouse_primary_button), rate_limited},
+           {dbus_input_interface, "setMouseCursorSpeed",
+            setter(&InputConfiguration::set_mouse_cursor_speed), rate_limited},
+           {dbus_input_interface, "setMouseScrollSpeed",
+            setter(&InputConfiguration::set_mouse_scroll_speed), rate_limited},
+           {dbus_input_interface, "setTouchpadPrimaryButton",
+            setter(&InputConfiguration::set_touchpad_primary_button), rate_limited},
+           {dbus_input_interface, "setTouchpadCursorSpeed",
+            setter(&InputConfiguration::set_touchpad_cursor_speed), rate_limited},
+           {dbus_input_interface, "setTouchpadScrollSpeed",
+            setter(&InputConfiguration::set_touchpad_scroll_speed), rate_limited},
+           {dbus_input_interface, "setTouchpadDisableWhileTyping",
+            setter(&InputConfiguration::set_disable_touchpad_while_typing), rate_limited},
+           {dbus_input_interface, "setTouchpadTapToClick",
+            setter(&InputConfiguration::set_tap_to_click), rate_limited},
+           {dbus_input_interface, "setTouchpadTwoFingerScroll",
+            setter(&InputConfiguration::set_two_finger_scroll), rate_limited},
+           {dbus_input_interface, "setTouchpadDisableWithMouse",
+            setter(&InputConfiguration::set_disable_touchpad_with_mouse), rate_limited},
+           {dbus_input_interface, "ApplySettings",
+            [this] (DBusMessage* message) { handle_ApplySettings(message); }, rate_limited},
+           {dbus_input_interface, "GetSettings",
+            [this] (DBusMessage* message) { handle_GetSettings(message); }, rate_limited}}},
+      rate_limiter{RateLimiter::default_burst, RateLimiter::default_calls_per_second}
+{
+    if (connection)
+    {
+        loop->add_connection(connection);
+        connection->request_name(dbus_input_service_name);
+        connection->register_object_path(dbus_input_path, handle_dbus_message_thunk, this);
+    }
+}
+
+usc::UnityInputService::~UnityInputService()
+{
+    if (connection)
+        connection->unregister_object_path(dbus_input_path);
+    for (auto const& peer : peer_connections)
+        peer->unregister_object_path(dbus_input_path);
+}
+
+void usc::UnityInputService::add_peer_connection(
+    std::shared_ptr<DBusConnectionHandle> const& peer)
+{
+    peer->register_object_path(dbus_input_path, handle_dbus_message_thunk, this);
+    peer_connections.push_back(peer);
+}
+
+void usc::UnityInputService::remove_peer_connection(
+    std::shared_ptr<DBusConnectionHandle> const& peer)
+{
+    auto const iter = std::find(begin(peer_connections), end(peer_connections), peer);
+    if (iter == end(peer_connections))
+        return;
+
+    peer->unregister_object_path(dbus_input_path);
+    peer_connections.erase(iter);
+    rate_limiter.forget_peer(*peer);
 }
 
 ::DBusHandlerResult usc::UnityInputService::handle_dbus_message_thunk(
@@ -50,100 +244,132 @@ usc::UnityInputService::UnityInputService(std::shared_ptr<usc::DBusEventLoop> co
     return dbus_input_service->handle_dbus_message(connection, message, user_data);
 }
 
-void usc::UnityInputService::handle_message(DBusMessage* message, void (usc::InputConfiguration::* method)(bool))
+template <typename T>
+usc::DBusMethodTable::Handler usc::UnityInputService::setter(void (usc::InputConfiguration::* method)(T))
 {
-    ScopedDBusError args_error;
-    dbus_bool_t flag{true};
-    dbus_message_get_args(
-        message, &args_error, DBUS_TYPE_BOOLEAN, &flag, DBUS_TYPE_INVALID);
+    return [this, method] (DBusMessage* message)
+        {
+            // The signature has already been checked against the introspection
+            typename DBusArgument<T>::Storage value{};
+            dbus_message_get_args(
+                message, nullptr, DBusArgument<T>::type, &value, DBUS_TYPE_INVALID);
 
-    if (!args_error)
-    {
-        (input_config.get()->*method)(flag);
+            (input_config.get()->*method)(value);
 
-        DBusMessageHandle reply{dbus_message_new_method_return(message)};
-        dbus_connection_send(*connection, reply, nullptr);
-    }
+            DBusMessageHandle reply{dbus_message_new_method_return(message)};
+            dbus_connection_send(calling_connection, reply, nullptr);
+        };
+}
+
+void usc::UnityInputService::handle_Introspect(DBusMessage* message)
+{
+    auto const reply = reply_cache.reply_to(
+        message, introspect_reply,
+        [] (DBusMessage* reply)
+        {
+            dbus_message_append_args(
+                reply,
+                DBUS_TYPE_STRING, &unity_input_service_introspection,
+                DBUS_TYPE_INVALID);
+        });
+
+    dbus_connection_send(calling_connection, reply, nullptr);
 }
 
-void usc::UnityInputService::handle_message(DBusMessage* message, void (usc::InputConfiguration::* method)(double))
+void usc::UnityInputService::handle_ApplySettings(DBusMessage* message)
 {
-    ScopedDBusError args_error;
-    double value{true};
-    dbus_message_get_args(
-        message, &args_error, DBUS_TYPE_DOUBLE, &value, DBUS_TYPE_INVALID);
+    // Start from the current settings, so that only the given ones change
+    auto settings = input_config->settings();
 
-    if (!args_error)
+    DBusMessageIter iter;
+    dbus_message_iter_init(message, &iter);
+
+    DBusMessageIter iter_dict;
+    dbus_message_iter_recurse(&iter, &iter_dict);
+
+    for (; dbus_message_iter_get_arg_type(&iter_dict) == DBUS_TYPE_DICT_ENTRY;
+         dbus_message_iter_next(&iter_dict))
     {
-        (input_config.get()->*method)(value);
+        DBusMessageIter iter_entry;
+        dbus_message_iter_recurse(&iter_dict, &iter_entry);
+
+        char const* key{""};
+        dbus_message_iter_get_basic(&iter_entry, &key);
+        dbus_message_iter_next(&iter_entry);
 
-        DBusMessageHandle reply{dbus_message_new_method_return(message)};
-        dbus_connection_send(*connection, reply, nullptr);
+        DBusMessageIter iter_variant;
+        dbus_message_iter_recurse(&iter_entry, &iter_variant);
+
+        auto const setting = setting_for(key);
+        if (!setting || !read_setting(&iter_variant, *setting, settings))
+        {
+            auto const error = std::string{setting ? "Invalid value for setting " : "Unknown setting "} + key;
+            DBusMessageHandle reply{
+                dbus_message_new_error(message, DBUS_ERROR_FAILED, error.c_str())};
+
+            dbus_connection_send(calling_connection, reply, nullptr);
+            return;
+        }
     }
+
+    input_config->apply_settings(settings);
+
+    DBusMessageHandle reply{dbus_message_new_method_return(message)};
+    dbus_connection_send(calling_connection, reply, nullptr);
 }
 
-void usc::UnityInputService::handle_message(DBusMessage* message, void (usc::InputConfiguration::* method)(int32_t))
+void usc::UnityInputService::handle_GetSettings(DBusMessage* message)
 {
-    ScopedDBusError args_error;
-    int32_t value{true};
-    dbus_message_get_args(
-        message, &args_error, DBUS_TYPE_INT32, &value, DBUS_TYPE_INVALID);
+    auto const settings = input_config->settings();
 
-    if (!args_error)
-    {
-        (input_config.get()->*method)(value);
+    DBusMessageHandle reply{dbus_message_new_method_return(message)};
 
-        DBusMessageHandle reply{dbus_message_new_method_return(message)};
-        dbus_connection_send(*connection, reply, nullptr);
-    }
+    DBusMessageIter iter;
+    dbus_message_iter_init_append(reply, &iter);
+
+    DBusMessageIter iter_dict;
+    dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY, "{sv}", &iter_dict);
+
+    for (auto const& setting : settings_by_key)
+        append_setting(&iter_dict, setting, settings);
+
+    dbus_message_iter_close_container(&iter, &iter_dict);
+
+    dbus_connection_send(calling_connection, reply, nullptr);
 }
 
 DBusHandlerResult usc::UnityInputService::handle_dbus_message(
     ::DBusConnection* connection, DBusMessage* message, void* user_data)
 {
-    ScopedDBusError args_error;
+    auto const method = method_table.find(message);
 
-    if (dbus_message_is_method_call(message, "org.freedesktop.DBus.Introspectable", "Introspect"))
+    // Every setter reconfigures all input devices, so clients can't be
+    // allowed to make us do that at any rate they like
+    if (method &&
+        method->rate_limited &&
+        !rate_limiter.admit(connection, message))
     {
-        DBusMessageHandle reply{
-            dbus_message_new_method_return(message),
-            DBUS_TYPE_STRING, &unity_input_service_introspection,
-            DBUS_TYPE_INVALID};
+         DBusMessageHandle reply{
+             dbus_message_new_error(message, DBUS_ERROR_LIMITS_EXCEEDED, "Too many requests")};
 
         dbus_connection_send(connection, reply, nullptr);
     }
-    else if (dbus_message_is_method_call(message, dbus_input_interface, "setMousePrimaryButton"))
-        handle_message(message, &InputConfiguration::set_mouse_primary_button);
-    else if (dbus_message_is_method_call(message, dbus_input_interface, "setMouseCursorSpeed"))
-        handle_message(message, &InputConfiguration::set_mouse_cursor_speed);
-    else if (dbus_message_is_method_call(message, dbus_input_interface, "setMouseScrollSpeed"))
-        handle_message(message, &InputConfiguration::set_mouse_scroll_speed);
-    else if (dbus_message_is_method_call(message, dbus_input_interface, "setTouchpadPrimaryButton"))
-        handle_message(message, &InputConfiguration::set_touchpad_primary_button);
-    else if (dbus_message_is_method_call(message, dbus_input_interface, "setTouchpadCursorSpeed"))
-        handle_message(message, &InputConfiguration::set_touchpad_cursor_speed);
-    else if (dbus_message_is_method_call(message, dbus_input_interface, "setTouchpadScrollSpeed"))
-        handle_message(message, &InputConfiguration::set_touchpad_scroll_speed);
-    else if (dbus_message_is_method_call(message, dbus_input_interface, "setTouchpadDisableWhileTyping"))
-        handle_message(message, &InputConfiguration::set_disable_touchpad_while_typing);
-    else if (dbus_message_is_method_call(message, dbus_input_interface, "setTouchpadTapToClick"))
-        handle_message(message, &InputConfiguration::set_tap_to_click);
-    else if (dbus_message_is_method_call(message, dbus_input_interface, "setTouchpadTwoFingerScroll"))
-        handle_message(message, &InputConfiguration::set_two_finger_scroll);
-    else if (dbus_message_is_method_call(message, dbus_input_interface, "setTouchpadDisableWithMouse"))
-        handle_message(message, &InputConfiguration::set_disable_touchpad_with_mouse);
-    else if (dbus_message_get_type(message) == DBUS_MESSAGE_TYPE_METHOD_CALL)
+    else if (method && method->accepts_arguments_of(message))
+    {
+        calling_connection = connection;
+        method->handler(message);
+    }
+    else if (method)
     {
          DBusMessageHandle reply{
-             dbus_message_new_error(message, DBUS_ERROR_FAILED, "Not supported")};
+             dbus_message_new_error(message, DBUS_ERROR_FAILED, "Invalid arguments")};
 
         dbus_connection_send(connection, reply, nullptr);
     }
-
-    if (args_error)
+    else if (dbus_message_get_type(message) == DBUS_MESSAGE_TYPE_METHOD_CALL)
     {
          DBusMessageHandle reply{
-             dbus_message_new_error(message, DBUS_ERROR_FAILED, "Invalid arguments")};
+             dbus_message_new_error(message, DBUS_ERROR_FAILED, "Not supported")};
 
         dbus_connection_send(connection, reply, nullptr);
     }
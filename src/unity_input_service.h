@@ -21,7 +21,11 @@
 
 #include <dbus/dbus.h>
 #include "dbus_connection_handle.h"
+#include "dbus_method_table.h"
+#include "dbus_reply_cache.h"
+#include "rate_limiter.h"
 #include <memory>
+#include <vector>
 
 namespace usc
 {
@@ -35,6 +39,17 @@ public:
         std::shared_ptr<usc::DBusEventLoop> const& loop,
         std::string const& address,
         std::shared_ptr<usc::InputConfiguration> const& input_config);
+    // A null connection exposes the service on peer connections only
+    UnityInputService(
+        std::shared_ptr<usc::DBusEventLoop> const& loop,
+        std::shared_ptr<usc::DBusConnectionHandle> const& connection,
+        std::shared_ptr<usc::InputConfiguration> const& input_config);
+    ~UnityInputService();
+
+    // Exposes the service on a peer-to-peer connection, which needs no
+    // bus name. Must be called on the loop thread.
+    void add_peer_connection(std::shared_ptr<DBusConnectionHandle> const& peer);
+    void remove_peer_connection(std::shared_ptr<DBusConnectionHandle> const& peer);
 
 private:
     static ::DBusHandlerResult handle_dbus_message_thunk(
@@ -42,13 +57,21 @@ private:
     ::DBusHandlerResult handle_dbus_message(
         DBusConnection* connection, DBusMessage* message, void* user_data);
 
-    void handle_message(DBusMessage* message, void (usc::InputConfiguration::* method)(bool));
-    void handle_message(DBusMessage* message, void (usc::InputConfiguration::* method)(int32_t));
-    void handle_message(DBusMessage* message, void (usc::InputConfiguration::* method)(double));
+    template <typename T>
+    DBusMethodTable::Handler setter(void (usc::InputConfiguration::* method)(T));
+    void handle_Introspect(DBusMessage* message);
+    void handle_ApplySettings(DBusMessage* message);
+    void handle_GetSettings(DBusMessage* message);
 
     std::shared_ptr<usc::DBusEventLoop> const loop;
     std::shared_ptr<usc::DBusConnectionHandle> connection;
+    std::vector<std::shared_ptr<usc::DBusConnectionHandle>> peer_connections;
+    // The connection the message being handled arrived on
+    ::DBusConnection* calling_connection{nullptr};
     std::shared_ptr<usc::InputConfiguration> const input_config;
+    DBusMethodTable const method_table;
+    DBusReplyCache reply_cache;
+    RateLimiter rate_limiter;
 };
 
 }
@@ -16,41 +16,80 @@
 
 #include "unity_power_button_event_sink.h"
 #include "dbus_message_handle.h"
+#include "dbus_event_loop.h"
+#include "tracer.h"
 
 namespace
 {
 char const* const unity_power_button_name = "com.canonical.Unity.PowerButton";
 char const* const unity_power_button_path = "/com/canonical/Unity/PowerButton";
 char const* const unity_power_button_iface = "com.canonical.Unity.PowerButton";
+
+void send_signal(usc::DBusConnectionHandle const& connection, char const* name)
+{
+    usc::DBusMessageHandle signal{
+        dbus_message_new_signal(
+            unity_power_button_path,
+            unity_power_button_iface,
+            name)};
+
+    // The loop flushes the connection once it is done dispatching
+    dbus_connection_send(connection, signal, nullptr);
+}
 }
 
 usc::UnityPowerButtonEventSink::UnityPowerButtonEventSink(
-    std::string const& dbus_address)
-    : dbus_connection{dbus_address}
+    std::shared_ptr<DBusEventLoop> const& loop,
+    std::string const& dbus_address,
+    std::shared_ptr<Tracer> const& tracer)
+    : UnityPowerButtonEventSink{loop, std::make_shared<DBusConnectionHandle>(dbus_address), tracer}
 {
-    dbus_connection.request_name(unity_power_button_name);
 }
 
-void usc::UnityPowerButtonEventSink::notify_press()
+usc::UnityPowerButtonEventSink::UnityPowerButtonEventSink(
+    std::shared_ptr<DBusEventLoop> const& loop,
+    std::shared_ptr<DBusConnectionHandle> const& dbus_connection,
+    std::shared_ptr<Tracer> const& tracer)
+    : loop{loop},
+      dbus_connection{dbus_connection},
+      tracer{tracer},
+      signal_target{std::make_shared<SignalTarget>(SignalTarget{dbus_connection, tracer})}
 {
-    DBusMessageHandle signal{
-        dbus_message_new_signal(
-            unity_power_button_path,
-            unity_power_button_iface,
-            "Press")};
+    loop->add_connection(dbus_connection, DBusEventLoop::Priority::high);
+    dbus_connection->request_name(unity_power_button_name);
+}
+
+usc::UnityPowerButtonEventSink::~UnityPowerButtonEventSink()
+{
+    loop->remove_connection(dbus_connection);
+}
 
-    dbus_connection_send(dbus_connection, signal, nullptr);
-    dbus_connection_flush(dbus_connection);
+// Power button signals are never dropped, and go out ahead of other DBus
+// work since they are on the wake-up path
+void usc::UnityPowerButtonEventSink::notify_press()
+{
+    queue_signal("Press", "power_button_press_signal");
 }
 
 void usc::UnityPowerButtonEventSink::notify_release()
 {
-    DBusMessageHandle signal{
-        dbus_message_new_signal(
-            unity_power_button_path,
-            unity_power_button_iface,
-            "Release")};
+    queue_signal("Release", "power_button_release_signal");
+}
+
+// The signal is traced with the cause the key press was traced with, so
+// that it shows on the path from the key to the transition it leads to
+void usc::UnityPowerButtonEventSink::queue_signal(char const* name, char const* trace_point)
+{
+    loop->enqueue(
+        DBusEventLoop::Priority::high,
+        [weak_target = std::weak_ptr<SignalTarget const>{signal_target}, name, trace_point,
+         cause = tracer->pending_cause()]
+        {
+            auto const target = weak_target.lock();
+            if (!target)
+                return;
 
-    dbus_connection_send(dbus_connection, signal, nullptr);
-    dbus_connection_flush(dbus_connection);
+            target->tracer->trace(trace_point, 0, cause);
+            send_signal(*target->connection, name);
+        });
 }
@@ -20,19 +20,47 @@
 #include "power_button_event_sink.h"
 #include "dbus_connection_handle.h"
 
+#include <memory>
+#include <string>
+
 namespace usc
 {
+class DBusEventLoop;
+class Tracer;
 
 class UnityPowerButtonEventSink : public PowerButtonEventSink
 {
 public:
-    UnityPowerButtonEventSink(std::string const& dbus_address);
+    UnityPowerButtonEventSink(
+        std::shared_ptr<DBusEventLoop> const& loop,
+        std::string const& dbus_address,
+        std::shared_ptr<Tracer> const& tracer);
+    UnityPowerButtonEventSink(
+        std::shared_ptr<DBusEventLoop> const& loop,
+        std::shared_ptr<DBusConnectionHandle> const& dbus_connection,
+        std::shared_ptr<Tracer> const& tracer);
+    ~UnityPowerButtonEventSink();
 
+    // Signals are sent from the DBus event loop, so these never block
     void notify_press() override;
     void notify_release() override;
 
 private:
-    DBusConnectionHandle dbus_connection;
+    struct SignalTarget
+    {
+        std::shared_ptr<DBusConnectionHandle> const connection;
+        std::shared_ptr<Tracer> const tracer;
+    };
+
+    void queue_signal(char const* name, char const* trace_point);
+
+    std::shared_ptr<DBusEventLoop> const loop;
+    std::shared_ptr<DBusConnectionHandle> const dbus_connection;
+    std::shared_ptr<Tracer> const tracer;
+    // Queued signals only hold a weak reference to this, so that those
+    // still queued when the sink is destroyed are dropped, and those
+    // already being sent keep what they use alive until they are done
+    std::shared_ptr<SignalTarget const> const signal_target;
 };
 
 }
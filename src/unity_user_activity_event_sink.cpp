@@ -15,53 +15,84 @@
  */
 
 #include "unity_user_activity_event_sink.h"
-#include "unity_user_activity_type.h"
 #include "dbus_message_handle.h"
+#include "dbus_event_loop.h"
 
 namespace
 {
 char const* const unity_user_activity_name = "com.canonical.Unity.UserActivity";
 char const* const unity_user_activity_path = "/com/canonical/Unity/UserActivity";
 char const* const unity_user_activity_iface = "com.canonical.Unity.UserActivity";
+
+void send_activity(usc::DBusConnectionHandle const& connection, usc::UnityUserActivityType type)
+{
+    int const activity_type = static_cast<int>(type);
+
+    usc::DBusMessageHandle signal{
+        dbus_message_new_signal(
+            unity_user_activity_path,
+            unity_user_activity_iface,
+            "Activity"),
+        DBUS_TYPE_INT32, &activity_type,
+        DBUS_TYPE_INVALID};
+
+    // The loop flushes the connection once it is done dispatching
+    dbus_connection_send(connection, signal, nullptr);
+}
 }
 
 usc::UnityUserActivityEventSink::UnityUserActivityEventSink(
+    std::shared_ptr<DBusEventLoop> const& loop,
     std::string const& dbus_address)
-    : dbus_connection{dbus_address}
+    : UnityUserActivityEventSink{loop, std::make_shared<DBusConnectionHandle>(dbus_address)}
 {
-    dbus_connection.request_name(unity_user_activity_name);
 }
 
-void usc::UnityUserActivityEventSink::notify_activity_changing_power_state()
+usc::UnityUserActivityEventSink::UnityUserActivityEventSink(
+    std::shared_ptr<DBusEventLoop> const& loop,
+    std::shared_ptr<DBusConnectionHandle> const& dbus_connection)
+    : loop{loop},
+      dbus_connection{dbus_connection},
+      activity_queued{std::make_shared<ActivityQueued>()}
 {
-    int const changing_power_state =
-        static_cast<int>(UnityUserActivityType::changing_power_state);
+    for (auto& queued : *activity_queued)
+        queued = false;
 
-    DBusMessageHandle signal{
-        dbus_message_new_signal(
-            unity_user_activity_path,
-            unity_user_activity_iface,
-            "Activity"),
-        DBUS_TYPE_INT32, &changing_power_state,
-        DBUS_TYPE_INVALID};
+    loop->add_connection(dbus_connection);
+    dbus_connection->request_name(unity_user_activity_name);
+}
+
+usc::UnityUserActivityEventSink::~UnityUserActivityEventSink()
+{
+    loop->remove_connection(dbus_connection);
+}
 
-    dbus_connection_send(dbus_connection, signal, nullptr);
-    dbus_connection_flush(dbus_connection);
+void usc::UnityUserActivityEventSink::notify_activity_changing_power_state()
+{
+    queue_activity(UnityUserActivityType::changing_power_state);
 }
 
 void usc::UnityUserActivityEventSink::notify_activity_extending_power_state()
 {
-    int const extending_power_state =
-        static_cast<int>(UnityUserActivityType::extending_power_state);
+    queue_activity(UnityUserActivityType::extending_power_state);
+}
 
-    DBusMessageHandle signal{
-        dbus_message_new_signal(
-            unity_user_activity_path,
-            unity_user_activity_iface,
-            "Activity"),
-        DBUS_TYPE_INT32, &extending_power_state,
-        DBUS_TYPE_INVALID};
+void usc::UnityUserActivityEventSink::queue_activity(UnityUserActivityType type)
+{
+    if ((*activity_queued)[static_cast<int>(type)].exchange(true))
+        return;
+
+    loop->enqueue(
+        [weak_activity_queued = std::weak_ptr<ActivityQueued>{activity_queued},
+         connection = dbus_connection,
+         type]
+        {
+            auto const activity_queued = weak_activity_queued.lock();
+            if (!activity_queued)
+                return;
 
-    dbus_connection_send(dbus_connection, signal, nullptr);
-    dbus_connection_flush(dbus_connection);
+            // Clear first, so that activity from now on gets a signal of its own
+            (*activity_queued)[static_cast<int>(type)] = false;
+            send_activity(*connection, type);
+        });
 }
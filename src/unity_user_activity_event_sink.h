@@ -19,20 +19,43 @@
 
 #include "user_activity_event_sink.h"
 #include "dbus_connection_handle.h"
+#include "unity_user_activity_type.h"
+
+#include <array>
+#include <atomic>
+#include <memory>
 
 namespace usc
 {
+class DBusEventLoop;
 
 class UnityUserActivityEventSink : public UserActivityEventSink
 {
 public:
-    UnityUserActivityEventSink(std::string const& dbus_address);
-
+    UnityUserActivityEventSink(
+        std::shared_ptr<DBusEventLoop> const& loop,
+        std::string const& dbus_address);
+    UnityUserActivityEventSink(
+        std::shared_ptr<DBusEventLoop> const& loop,
+        std::shared_ptr<DBusConnectionHandle> const& dbus_connection);
+    ~UnityUserActivityEventSink();
+
+    // Signals are sent from the DBus event loop, so these never block.
+    // At most one signal of each activity type is queued at any time;
+    // notifications arriving while one is queued are merged into it.
     void notify_activity_changing_power_state() override;
     void notify_activity_extending_power_state() override;
 
 private:
-    DBusConnectionHandle dbus_connection;
+    using ActivityQueued = std::array<std::atomic<bool>, 2>;
+
+    void queue_activity(UnityUserActivityType type);
+
+    std::shared_ptr<DBusEventLoop> const loop;
+    std::shared_ptr<DBusConnectionHandle> const dbus_connection;
+    // Queued signals only hold a weak reference to this, so that those
+    // still queued when the sink is destroyed are dropped
+    std::shared_ptr<ActivityQueued> const activity_queued;
 };
 
 }
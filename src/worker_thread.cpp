@@ -0,0 +1,84 @@
+/*
+ * Copyright © 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "worker_thread.h"
+#include "thread_name.h"
+
+usc::WorkerThread::WorkerThread(std::string const& name)
+    : stopping{false},
+      discarding{false},
+      thread{[this, name] { run(name); }}
+{
+}
+
+usc::WorkerThread::~WorkerThread()
+{
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        stopping = true;
+    }
+
+    tasks_changed.notify_one();
+    if (thread.joinable())
+        thread.join();
+}
+
+void usc::WorkerThread::queue(Task&& task)
+{
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        if (discarding)
+            return;
+        tasks.push_back(std::move(task));
+    }
+
+    tasks_changed.notify_one();
+}
+
+void usc::WorkerThread::finish()
+{
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        stopping = true;
+        discarding = true;
+    }
+
+    tasks_changed.notify_one();
+    if (thread.joinable())
+        thread.join();
+}
+
+void usc::WorkerThread::run(std::string const& name)
+{
+    usc::set_thread_name(name);
+
+    std::unique_lock<std::mutex> lock{mutex};
+
+    while (true)
+    {
+        tasks_changed.wait(lock, [this] { return stopping || !tasks.empty(); });
+
+        if (tasks.empty())
+            break;
+
+        auto task = std::move(tasks.front());
+        tasks.pop_front();
+
+        lock.unlock();
+        task();
+        lock.lock();
+    }
+}
@@ -0,0 +1,65 @@
+/*
+ * Copyright © 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef USC_WORKER_THREAD_H_
+#define USC_WORKER_THREAD_H_
+
+#include "task.h"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace usc
+{
+
+/*
+ * Runs queued tasks, one at a time and in queue order, on a thread of its
+ * own. Meant for slow, blocking work (e.g. display reconfiguration) that
+ * would otherwise hold up an event loop.
+ */
+class WorkerThread
+{
+public:
+    explicit WorkerThread(std::string const& name);
+    // Runs the tasks that are still queued before returning
+    ~WorkerThread();
+
+    void queue(Task&& task);
+
+    // Returns once the tasks that are still queued have run. Tasks queued
+    // afterwards never run.
+    void finish();
+
+private:
+    WorkerThread(WorkerThread const&) = delete;
+    WorkerThread& operator=(WorkerThread const&) = delete;
+
+    void run(std::string const& name);
+
+    std::mutex mutex;
+    std::condition_variable tasks_changed;
+    std::deque<Task> tasks;
+    bool stopping;
+    bool discarding;
+    std::thread thread;
+};
+
+}
+
+#endif
@@ -72,10 +72,10 @@ struct MockDisplay : mir::graphics::Display, mir::graphics::NativeDisplay
         return this;
     }
 
-    bool apply_if_configuration_preserves_display_buffers(mir::graphics::DisplayConfiguration const& conf) override
-    {
-        return false;
-    }
+    // Returns false unless told otherwise, i.e. every configuration
+    // change needs the compositor to be stopped
+    MOCK_METHOD1(apply_if_configuration_preserves_display_buffers,
+                 bool(mir::graphics::DisplayConfiguration const& conf));
 
     mir::graphics::Frame last_frame_on(unsigned output_id) const override
     {
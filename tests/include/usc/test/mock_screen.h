@@ -34,6 +34,9 @@ struct MockScreen : usc::Screen
     MOCK_METHOD1(turn_on, void(OutputFilter));
     MOCK_METHOD1(turn_off, void(OutputFilter));
     MOCK_METHOD1(register_active_outputs_handler, void(ActiveOutputsHandler const&));
+    MOCK_METHOD1(turn_on_output, void(OutputId));
+    MOCK_METHOD1(turn_off_output, void(OutputId));
+    MOCK_METHOD1(register_outputs_handler, void(OutputsHandler const&));
 };
 
 }
@@ -19,6 +19,8 @@
 
 #include <mir/graphics/display_configuration.h>
 
+#include <vector>
+
 namespace usc
 {
 namespace test
@@ -66,36 +68,32 @@ struct StubDisplayConfiguration : mir::graphics::DisplayConfiguration
 
     void for_each_output(std::function<void(mir::graphics::DisplayConfigurationOutput const&)> f) const override
     {
-        for (int i = 0; i < num_internal_active_outputs; ++i)
-            f(internal_active_conf_output);
-        for (int i = 0; i < num_external_active_outputs; ++i)
-            f(external_active_conf_output);
-        for (int i = 0; i < num_inactive_outputs; ++i)
-            f(inactive_conf_output);
+        for (auto const& output : the_outputs())
+            f(output);
     }
 
     void for_each_output(std::function<void(mir::graphics::UserDisplayConfigurationOutput&)> f)
     {
-        for (int i = 0; i < num_internal_active_outputs; ++i)
-        {
-            mir::graphics::UserDisplayConfigurationOutput user{internal_active_conf_output};
-            f(user);
-        }
-        for (int i = 0; i < num_external_active_outputs; ++i)
+        for (auto& output : the_outputs())
         {
-            mir::graphics::UserDisplayConfigurationOutput user{external_active_conf_output};
-            f(user);
-        }
-        for (int i = 0; i < num_inactive_outputs; ++i)
-        {
-            mir::graphics::UserDisplayConfigurationOutput user{inactive_conf_output};
+            mir::graphics::UserDisplayConfigurationOutput user{output};
             f(user);
         }
     }
 
     std::unique_ptr<mir::graphics::DisplayConfiguration> clone() const override
     {
-        return std::make_unique<StubDisplayConfiguration>(internal_active_conf_output);
+        auto copy = std::make_unique<StubDisplayConfiguration>(
+            num_internal_active_outputs,
+            num_external_active_outputs,
+            num_inactive_outputs);
+
+        copy->internal_active_conf_output = internal_active_conf_output;
+        copy->external_active_conf_output = external_active_conf_output;
+        copy->inactive_conf_output = inactive_conf_output;
+        copy->outputs = the_outputs();
+
+        return std::move(copy);
     }
 
     int num_internal_active_outputs{1};
@@ -105,6 +103,33 @@ struct StubDisplayConfiguration : mir::graphics::DisplayConfiguration
     mir::graphics::DisplayConfigurationOutput internal_active_conf_output;
     mir::graphics::DisplayConfigurationOutput external_active_conf_output;
     mir::graphics::DisplayConfigurationOutput inactive_conf_output;
+
+private:
+    // Made from the templates above on first use, giving each output
+    // its own id like a real configuration does
+    std::vector<mir::graphics::DisplayConfigurationOutput>& the_outputs() const
+    {
+        if (outputs.empty())
+        {
+            auto const add = [this] (mir::graphics::DisplayConfigurationOutput const& output, int count)
+                {
+                    for (int i = 0; i < count; ++i)
+                    {
+                        outputs.push_back(output);
+                        outputs.back().id =
+                            mir::graphics::DisplayConfigurationOutputId{static_cast<int>(outputs.size())};
+                    }
+                };
+
+            add(internal_active_conf_output, num_internal_active_outputs);
+            add(external_active_conf_output, num_external_active_outputs);
+            add(inactive_conf_output, num_inactive_outputs);
+        }
+
+        return outputs;
+    }
+
+    mutable std::vector<mir::graphics::DisplayConfigurationOutput> outputs;
 };
 
 }
@@ -88,6 +88,17 @@ int ut::DBusAsyncReplyInt::get()
     return val;
 }
 
+uint64_t ut::DBusAsyncReplyUInt64::get()
+{
+    auto reply = ut::DBusAsyncReply::get();
+    throw_on_invalid_reply(reply);
+    throw_on_error_reply(reply);
+
+    dbus_uint64_t val{0};
+    dbus_message_get_args(reply, nullptr, DBUS_TYPE_UINT64, &val, DBUS_TYPE_INVALID);
+    return val;
+}
+
 bool ut::DBusAsyncReplyBool::get()
 {
     auto reply = ut::DBusAsyncReply::get();
@@ -149,3 +160,28 @@ void ut::DBusClient::DBusClient::disconnect()
 
     return pending_reply;
 }
+
+::DBusPendingCall* ut::DBusClient::invoke_with_pending(
+    char const* interface, char const* method,
+    std::function<void(DBusMessageIter*)> const& append_args)
+{
+    static int const timeout_ms = 5000;
+
+    usc::DBusMessageHandle msg{
+        dbus_message_new_method_call(
+            destination.c_str(),
+            path.c_str(),
+            interface,
+            method)};
+
+    DBusMessageIter iter;
+    dbus_message_iter_init_append(msg, &iter);
+    append_args(&iter);
+
+    DBusPendingCall* pending_reply;
+    dbus_connection_send_with_reply(
+        connection, msg, &pending_reply, timeout_ms);
+    dbus_connection_flush(connection);
+
+    return pending_reply;
+}
@@ -21,6 +21,8 @@
 
 #include "src/dbus_connection_handle.h"
 
+#include <cstdint>
+#include <functional>
 #include <string>
 
 #include <dbus/dbus.h>
@@ -67,6 +69,13 @@ public:
     int get();
 };
 
+class DBusAsyncReplyUInt64 : DBusAsyncReply
+{
+public:
+    using DBusAsyncReply::DBusAsyncReply;
+    uint64_t get();
+};
+
 class DBusAsyncReplyBool : DBusAsyncReply
 {
 public:
@@ -101,6 +110,10 @@ public:
 protected:
     DBusPendingCall* invoke_with_pending(
         char const* interface, char const* method, int first_arg_type, ...);
+    // For calls with arguments that need to be appended with an iterator
+    DBusPendingCall* invoke_with_pending(
+        char const* interface, char const* method,
+        std::function<void(DBusMessageIter*)> const& append_args);
     usc::DBusConnectionHandle connection;
     std::string const destination;
     std::string const path;
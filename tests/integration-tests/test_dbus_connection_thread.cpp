@@ -0,0 +1,91 @@
+/*
+ * Copyright © 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "src/dbus_connection_thread.h"
+#include "src/dbus_event_loop.h"
+
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <future>
+#include <thread>
+
+using namespace testing;
+
+namespace
+{
+
+struct ADBusConnectionThread : testing::Test
+{
+    std::thread::id thread_of(usc::DBusEventLoop& loop)
+    {
+        std::promise<std::thread::id> id;
+        loop.enqueue([&] { id.set_value(std::this_thread::get_id()); });
+        return id.get_future().get();
+    }
+
+    std::shared_ptr<usc::DBusEventLoop> const display_loop{std::make_shared<usc::DBusEventLoop>()};
+    std::shared_ptr<usc::DBusEventLoop> const input_loop{std::make_shared<usc::DBusEventLoop>()};
+};
+
+}
+
+TEST_F(ADBusConnectionThread, runs_each_loop_on_its_own_thread)
+{
+    usc::DBusConnectionThread const thread{{display_loop, input_loop}};
+
+    auto const display_thread = thread_of(*display_loop);
+    auto const input_thread = thread_of(*input_loop);
+
+    EXPECT_THAT(display_thread, Ne(input_thread));
+    EXPECT_THAT(display_thread, Ne(std::this_thread::get_id()));
+    EXPECT_THAT(input_thread, Ne(std::this_thread::get_id()));
+}
+
+TEST_F(ADBusConnectionThread, supports_enqueuing_actions_across_loops)
+{
+    usc::DBusConnectionThread const thread{{display_loop, input_loop}};
+
+    std::promise<std::thread::id> ran_on;
+
+    display_loop->enqueue(
+        [&]
+        {
+            input_loop->enqueue([&] { ran_on.set_value(std::this_thread::get_id()); });
+        });
+
+    EXPECT_THAT(ran_on.get_future().get(), Eq(thread_of(*input_loop)));
+}
+
+TEST_F(ADBusConnectionThread, keeps_blocked_loop_from_delaying_others)
+{
+    // Outlives the thread, so that the blocked action is done with it
+    // before it goes
+    std::promise<void> unblock;
+    auto unblocked = unblock.get_future();
+
+    usc::DBusConnectionThread const thread{{display_loop, input_loop}};
+
+    display_loop->enqueue([&] { unblocked.wait(); });
+
+    std::promise<void> input_ran;
+    input_loop->enqueue([&] { input_ran.set_value(); });
+
+    EXPECT_THAT(input_ran.get_future().wait_for(std::chrono::seconds{3}),
+                Eq(std::future_status::ready));
+
+    unblock.set_value();
+}
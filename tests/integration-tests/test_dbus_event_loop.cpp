@@ -22,6 +22,7 @@
 #include "src/scoped_dbus_error.h"
 #include "dbus_bus.h"
 #include "dbus_client.h"
+#include "spin_wait.h"
 
 #include <gtest/gtest.h>
 #include <gmock/gmock.h>
@@ -162,6 +163,25 @@ TEST_F(ADBusEventLoop, dispatches_received_message)
     EXPECT_THAT(reply.get(), expected);
 }
 
+TEST_F(ADBusEventLoop, keeps_connection_until_each_user_has_removed_it)
+{
+    using namespace testing;
+
+    std::promise<void> added_again;
+    dbus_event_loop.enqueue(
+        [&]
+        {
+            dbus_event_loop.add_connection(connection);
+            added_again.set_value();
+        });
+    added_again.get_future().wait();
+
+    // Deferred to the loop thread
+    dbus_event_loop.remove_connection(connection);
+
+    EXPECT_THAT(client.request_add(1, 2).get(), Eq(3));
+}
+
 TEST_F(ADBusEventLoop, enqueues_send_requests)
 {
     dbus_event_loop.enqueue(
@@ -231,3 +251,277 @@ TEST_F(ADBusEventLoop, handles_reply_timeouts)
     EXPECT_THAT(delay, Lt(std::chrono::milliseconds{timeout_ms * 10}));
     EXPECT_THAT(delay, Ge(std::chrono::milliseconds{timeout_ms}));
 }
+
+TEST_F(ADBusEventLoop, dispatches_bursts_of_received_messages)
+{
+    using namespace testing;
+
+    int const num_requests = 50;
+
+    std::vector<ut::DBusAsyncReplyInt> replies;
+    for (int i = 0; i < num_requests; ++i)
+        replies.push_back(client.request_add(i, i));
+
+    for (int i = 0; i < num_requests; ++i)
+        EXPECT_THAT(replies[i].get(), Eq(2 * i));
+}
+
+TEST_F(ADBusEventLoop, coalesces_wake_ups_requested_while_busy)
+{
+    using namespace testing;
+
+    int const num_signals = 10;
+
+    std::promise<void> loop_blocked;
+    std::promise<void> unblock_loop;
+    auto unblock_loop_future = unblock_loop.get_future();
+
+    dbus_event_loop.enqueue(
+        [&]
+        {
+            loop_blocked.set_value();
+            unblock_loop_future.wait();
+        });
+
+    loop_blocked.get_future().wait();
+
+    // Queueing outgoing messages asks the loop to wake up
+    for (int i = 0; i < num_signals; ++i)
+    {
+        usc::DBusMessageHandle msg{
+            dbus_message_new_signal(
+                test_service_path,
+                test_service_interface,
+                "signal")};
+
+        dbus_connection_send(*connection, msg, nullptr);
+    }
+
+    unblock_loop.set_value();
+
+    for (int i = 0; i < num_signals; ++i)
+        client.listen_for_signal();
+
+    EXPECT_TRUE(ut::spin_wait_for_condition_or_timeout(
+        [this] { return dbus_event_loop.coalesced_wake_ups() > 0; },
+        default_timeout));
+}
+
+TEST_F(ADBusEventLoop, dispatches_high_priority_actions_first)
+{
+    using namespace testing;
+
+    std::promise<void> loop_blocked;
+    std::promise<void> unblock_loop;
+    auto unblock_loop_future = unblock_loop.get_future();
+    std::promise<void> all_dispatched;
+
+    std::vector<std::string> dispatched;
+
+    dbus_event_loop.enqueue(
+        [&]
+        {
+            loop_blocked.set_value();
+            unblock_loop_future.wait();
+        });
+
+    loop_blocked.get_future().wait();
+
+    dbus_event_loop.enqueue(
+        [&] { dispatched.push_back("normal"); all_dispatched.set_value(); });
+    dbus_event_loop.enqueue(
+        usc::DBusEventLoop::Priority::high,
+        [&] { dispatched.push_back("high"); });
+
+    unblock_loop.set_value();
+    all_dispatched.get_future().wait();
+
+    EXPECT_THAT(dispatched, ElementsAre("high", "normal"));
+}
+
+TEST_F(ADBusEventLoop, runs_delayed_actions_after_their_delay)
+{
+    using namespace testing;
+
+    std::chrono::milliseconds const delay{50};
+    std::promise<std::chrono::steady_clock::time_point> ran;
+
+    auto const start = std::chrono::steady_clock::now();
+
+    dbus_event_loop.enqueue_after(
+        delay, [&] { ran.set_value(std::chrono::steady_clock::now()); });
+
+    auto const end = ran.get_future().get();
+
+    EXPECT_THAT(end - start, Ge(delay));
+    // Use a high upper bound for valgrind runs to succeed
+    EXPECT_THAT(end - start, Lt(delay * 10));
+}
+
+TEST_F(ADBusEventLoop, does_not_run_cancelled_delayed_actions)
+{
+    using namespace testing;
+
+    std::atomic<bool> cancelled_ran{false};
+    std::promise<void> later_ran;
+
+    auto const id = dbus_event_loop.enqueue_after(
+        std::chrono::milliseconds{10}, [&] { cancelled_ran = true; });
+    dbus_event_loop.enqueue_after(
+        std::chrono::milliseconds{50}, [&] { later_ran.set_value(); });
+
+    EXPECT_TRUE(dbus_event_loop.cancel(id));
+
+    later_ran.get_future().wait();
+
+    EXPECT_FALSE(cancelled_ran);
+    EXPECT_FALSE(dbus_event_loop.cancel(id));
+}
+
+TEST_F(ADBusEventLoop, records_action_latency_and_run_time)
+{
+    using namespace testing;
+
+    std::chrono::milliseconds const run_time{20};
+    std::promise<void> done;
+
+    dbus_event_loop.enqueue([&] { std::this_thread::sleep_for(run_time); });
+    dbus_event_loop.enqueue([&] { done.set_value(); });
+    done.get_future().wait();
+
+    EXPECT_TRUE(ut::spin_wait_for_condition_or_timeout(
+        [this] { return dbus_event_loop.statistics().handler_run_time.samples >= 2; },
+        default_timeout));
+
+    auto const statistics = dbus_event_loop.statistics();
+    EXPECT_THAT(statistics.action_latency.samples, Ge(2u));
+    // The second action waited for the first one to finish
+    EXPECT_THAT(statistics.action_latency.max, Ge(static_cast<uint64_t>(run_time.count() * 1000)));
+    EXPECT_THAT(statistics.handler_run_time.max, Ge(static_cast<uint64_t>(run_time.count() * 1000)));
+}
+
+TEST_F(ADBusEventLoop, counts_stalled_iterations)
+{
+    using namespace testing;
+
+    auto const stall = usc::DBusEventLoop::default_stall_threshold * 2;
+
+    dbus_event_loop.enqueue([&] { std::this_thread::sleep_for(stall); });
+
+    EXPECT_TRUE(ut::spin_wait_for_condition_or_timeout(
+        [this] { return dbus_event_loop.statistics().stalled_iterations == 1; },
+        default_timeout));
+}
+
+TEST_F(ADBusEventLoop, drains_actions_enqueued_before_it_is_asked_to)
+{
+    std::promise<void> started;
+    std::promise<void> finish;
+    auto finished = finish.get_future();
+    std::atomic<bool> queued_ran{false};
+
+    dbus_event_loop.enqueue(
+        usc::DBusEventLoop::Priority::high,
+        [&] { started.set_value(); finished.wait(); });
+    dbus_event_loop.enqueue(
+        usc::DBusEventLoop::Priority::high,
+        [&] { queued_ran = true; });
+    started.get_future().wait();
+
+    auto const draining = std::async(std::launch::async,
+        [this] { dbus_event_loop.drain(usc::DBusEventLoop::Priority::high); });
+
+    EXPECT_EQ(std::future_status::timeout,
+              draining.wait_for(std::chrono::milliseconds{50}));
+
+    finish.set_value();
+
+    EXPECT_EQ(std::future_status::ready, draining.wait_for(default_timeout));
+    EXPECT_TRUE(queued_ran);
+}
+
+TEST(ADBusEventLoopNotYetRunning, dispatches_messages_received_before_it_started)
+{
+    using namespace testing;
+
+    ut::DBusBus bus;
+    auto const connection = std::make_shared<usc::DBusConnectionHandle>(bus.address());
+    connection->request_name(test_service_name);
+
+    auto const reply_with_sum =
+        [] (::DBusConnection* connection, DBusMessage* message, void*)
+        {
+            int32_t a{0};
+            int32_t b{0};
+            if (dbus_message_is_method_call(message, test_service_interface, "add") &&
+                dbus_message_get_args(
+                    message, nullptr,
+                    DBUS_TYPE_INT32, &a,
+                    DBUS_TYPE_INT32, &b,
+                    DBUS_TYPE_INVALID))
+            {
+                int32_t const result{a + b};
+                usc::DBusMessageHandle reply{
+                    dbus_message_new_method_return(message),
+                    DBUS_TYPE_INT32, &result,
+                    DBUS_TYPE_INVALID};
+
+                dbus_connection_send(connection, reply, nullptr);
+            }
+            return DBUS_HANDLER_RESULT_HANDLED;
+        };
+    connection->add_filter(reply_with_sum, nullptr);
+
+    TestDBusClient client{bus.address()};
+    auto reply = client.request_add(11, 13);
+
+    // Make sure the request has been read and queued before the loop starts
+    while (dbus_connection_get_dispatch_status(*connection) != DBUS_DISPATCH_DATA_REMAINS)
+        dbus_connection_read_write(*connection, 10);
+
+    usc::DBusEventLoop dbus_event_loop;
+    dbus_event_loop.add_connection(connection);
+
+    std::promise<void> event_loop_started;
+    std::thread dbus_loop_thread{
+        [&] { dbus_event_loop.run(event_loop_started); }};
+    event_loop_started.get_future().wait();
+
+    EXPECT_THAT(reply.get(), Eq(24));
+
+    dbus_event_loop.stop();
+    dbus_loop_thread.join();
+}
+
+TEST(ADBusEventLoopNotYetRunning, does_not_wait_to_drain)
+{
+    usc::DBusEventLoop dbus_event_loop;
+    bool ran{false};
+
+    dbus_event_loop.enqueue(usc::DBusEventLoop::Priority::high, [&] { ran = true; });
+    dbus_event_loop.drain(usc::DBusEventLoop::Priority::high);
+
+    EXPECT_FALSE(ran);
+}
+
+TEST(ADBusEventLoopNotYetRunning, raises_shared_connections_to_the_highest_priority_of_their_users)
+{
+    using namespace testing;
+
+    ut::DBusBus bus;
+    auto const connection = std::make_shared<usc::DBusConnectionHandle>(bus.address());
+    auto const other_connection = std::make_shared<usc::DBusConnectionHandle>(bus.address());
+
+    usc::DBusEventLoop dbus_event_loop;
+    dbus_event_loop.add_connection(connection, usc::DBusEventLoop::Priority::normal);
+    dbus_event_loop.add_connection(connection, usc::DBusEventLoop::Priority::high);
+    dbus_event_loop.add_connection(other_connection, usc::DBusEventLoop::Priority::high);
+    dbus_event_loop.add_connection(other_connection, usc::DBusEventLoop::Priority::normal);
+
+    EXPECT_THAT(dbus_event_loop.priority_of(connection), Eq(usc::DBusEventLoop::Priority::high));
+    EXPECT_THAT(dbus_event_loop.priority_of(other_connection), Eq(usc::DBusEventLoop::Priority::high));
+
+    // The priority stays raised while any user is left
+    dbus_event_loop.remove_connection(connection);
+    EXPECT_THAT(dbus_event_loop.priority_of(connection), Eq(usc::DBusEventLoop::Priority::high));
+}
@@ -0,0 +1,209 @@
+/*
+ * Copyright © 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "src/dbus_peer_server.h"
+#include "src/dbus_connection_handle.h"
+#include "src/dbus_connection_thread.h"
+#include "src/dbus_event_loop.h"
+#include "src/dbus_message_handle.h"
+#include "src/scoped_dbus_error.h"
+#include "src/unity_display_service.h"
+#include "src/tracer.h"
+#include "src/unity_display_service_introspection.h"
+#include "src/unity_input_service.h"
+#include "wait_condition.h"
+
+#include "usc/test/mock_input_configuration.h"
+#include "usc/test/mock_screen.h"
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+
+namespace ut = usc::test;
+using namespace testing;
+
+namespace
+{
+
+struct FakeScreen : ut::MockScreen
+{
+    void register_active_outputs_handler(usc::ActiveOutputsHandler const& handler)
+    {
+        std::lock_guard<std::mutex> lock{active_outputs_mutex};
+        active_outputs_handler = handler;
+    }
+
+    void notify_active_outputs(usc::ActiveOutputs const& active_outputs)
+    {
+        std::lock_guard<std::mutex> lock{active_outputs_mutex};
+        active_outputs_handler(active_outputs);
+    }
+
+    std::mutex active_outputs_mutex;
+    usc::ActiveOutputsHandler active_outputs_handler{[](usc::ActiveOutputs const&){}};
+};
+
+struct ADBusPeerServer : testing::Test
+{
+    std::shared_ptr<usc::DBusConnectionHandle> connect()
+    {
+        return std::make_shared<usc::DBusConnectionHandle>(
+            peer_server.address(), usc::DBusConnectionHandle::PeerToPeer{});
+    }
+
+    usc::DBusMessageHandle call(
+        usc::DBusConnectionHandle const& peer,
+        char const* path, char const* interface, char const* method,
+        int first_arg_type, ...)
+    {
+        va_list args;
+        va_start(args, first_arg_type);
+        usc::DBusMessageHandle message{
+            dbus_message_new_method_call(nullptr, path, interface, method),
+            first_arg_type, args};
+        va_end(args);
+
+        usc::ScopedDBusError error;
+        usc::DBusMessageHandle reply{
+            dbus_connection_send_with_reply_and_block(peer, message, 5000, &error)};
+        if (error)
+            throw std::runtime_error(error.message_str());
+
+        return reply;
+    }
+
+    usc::DBusMessageHandle wait_for_signal(usc::DBusConnectionHandle const& peer)
+    {
+        auto const deadline = std::chrono::steady_clock::now() + std::chrono::seconds{5};
+
+        while (std::chrono::steady_clock::now() < deadline)
+        {
+            dbus_connection_read_write(peer, 1);
+            usc::DBusMessageHandle message{dbus_connection_pop_message(peer)};
+
+            if (message && dbus_message_get_type(message) == DBUS_MESSAGE_TYPE_SIGNAL)
+                return message;
+        }
+
+        return usc::DBusMessageHandle{nullptr};
+    }
+
+    std::shared_ptr<usc::DBusEventLoop> const dbus_loop{std::make_shared<usc::DBusEventLoop>()};
+    std::shared_ptr<FakeScreen> const fake_screen{std::make_shared<NiceMock<FakeScreen>>()};
+    std::shared_ptr<ut::MockInputConfiguration> const input_config{
+        std::make_shared<NiceMock<ut::MockInputConfiguration>>()};
+    // Without a bus connection the services are only reachable by peers
+    usc::UnityDisplayService display_service{
+        dbus_loop,
+        std::shared_ptr<usc::DBusConnectionHandle>{},
+        fake_screen,
+        std::make_shared<usc::Tracer>()};
+    usc::UnityInputService input_service{
+        dbus_loop, std::shared_ptr<usc::DBusConnectionHandle>{}, input_config};
+    ut::WaitCondition peer_disconnected;
+    usc::DBusPeerServer peer_server{
+        dbus_loop,
+        "unix:tmpdir=/tmp",
+        usc::DBusEventLoop::Priority::high,
+        [this] (std::shared_ptr<usc::DBusConnectionHandle> const& peer)
+        {
+            display_service.add_peer_connection(peer);
+            input_service.add_peer_connection(peer);
+        },
+        [this] (std::shared_ptr<usc::DBusConnectionHandle> const& peer)
+        {
+            input_service.remove_peer_connection(peer);
+            display_service.remove_peer_connection(peer);
+            peer_disconnected.wake_up();
+        }};
+    std::shared_ptr<usc::DBusConnectionThread> const dbus_thread{
+        std::make_shared<usc::DBusConnectionThread>(dbus_loop)};
+};
+
+}
+
+TEST_F(ADBusPeerServer, serves_display_service_to_peers)
+{
+    auto const peer = connect();
+
+    EXPECT_CALL(*fake_screen, turn_on(usc::OutputFilter::internal));
+
+    auto const introspection = call(
+        *peer, "/com/canonical/Unity/Display", "org.freedesktop.DBus.Introspectable", "Introspect",
+        DBUS_TYPE_INVALID);
+
+    char const* filter{"internal"};
+    call(*peer, "/com/canonical/Unity/Display", "com.canonical.Unity.Display", "TurnOn",
+         DBUS_TYPE_STRING, &filter, DBUS_TYPE_INVALID);
+
+    char const* xml{""};
+    dbus_message_get_args(introspection, nullptr, DBUS_TYPE_STRING, &xml, DBUS_TYPE_INVALID);
+    EXPECT_THAT(xml, StrEq(unity_display_service_introspection));
+}
+
+TEST_F(ADBusPeerServer, serves_input_service_to_peers)
+{
+    auto const peer = connect();
+
+    EXPECT_CALL(*input_config, set_mouse_primary_button(1));
+
+    int32_t const button{1};
+    call(*peer, "/com/canonical/Unity/Input", "com.canonical.Unity.Input", "setMousePrimaryButton",
+         DBUS_TYPE_INT32, &button, DBUS_TYPE_INVALID);
+}
+
+TEST_F(ADBusPeerServer, sends_property_changes_to_peers)
+{
+    auto const first_peer = connect();
+    auto const second_peer = connect();
+
+    // Make sure both peers have been accepted
+    call(*first_peer, "/com/canonical/Unity/Display", "org.freedesktop.DBus.Introspectable", "Introspect",
+         DBUS_TYPE_INVALID);
+    call(*second_peer, "/com/canonical/Unity/Display", "org.freedesktop.DBus.Introspectable", "Introspect",
+         DBUS_TYPE_INVALID);
+
+    fake_screen->notify_active_outputs({1, 0});
+
+    for (auto const& peer : {first_peer, second_peer})
+    {
+        auto const signal = wait_for_signal(*peer);
+        ASSERT_TRUE(signal);
+        EXPECT_TRUE(dbus_message_is_signal(signal, "org.freedesktop.DBus.Properties", "PropertiesChanged"));
+    }
+}
+
+TEST_F(ADBusPeerServer, forgets_peers_that_disconnect)
+{
+    auto peer = connect();
+    call(*peer, "/com/canonical/Unity/Display", "org.freedesktop.DBus.Introspectable", "Introspect",
+         DBUS_TYPE_INVALID);
+
+    peer.reset();
+    peer_disconnected.wait_for(std::chrono::seconds{5});
+    EXPECT_TRUE(peer_disconnected.woken());
+
+    // Signals are only sent to the peers that are still around
+    auto const other_peer = connect();
+    call(*other_peer, "/com/canonical/Unity/Display", "org.freedesktop.DBus.Introspectable", "Introspect",
+         DBUS_TYPE_INVALID);
+    fake_screen->notify_active_outputs({1, 0});
+    EXPECT_TRUE(wait_for_signal(*other_peer));
+}
@@ -22,6 +22,7 @@
 #include "src/dbus_event_loop.h"
 #include "src/dbus_message_handle.h"
 #include "src/screen.h"
+#include "src/tracer.h"
 #include "src/unity_display_service_introspection.h"
 #include "wait_condition.h"
 #include "dbus_bus.h"
@@ -32,8 +33,11 @@
 #include <gtest/gtest.h>
 #include <gmock/gmock.h>
 
+#include <future>
 #include <stdexcept>
 #include <memory>
+#include <string>
+#include <vector>
 
 namespace ut = usc::test;
 
@@ -54,8 +58,21 @@ struct FakeScreen : ut::MockScreen
         active_outputs_handler(active_outputs);
     }
 
+    void register_outputs_handler(usc::OutputsHandler const& handler)
+    {
+        std::lock_guard<std::mutex> lock{active_outputs_mutex};
+        outputs_handler = handler;
+    }
+
+    void notify_outputs(usc::Outputs const& outputs)
+    {
+        std::lock_guard<std::mutex> lock{active_outputs_mutex};
+        outputs_handler(outputs);
+    }
+
     std::mutex active_outputs_mutex;
     usc::ActiveOutputsHandler active_outputs_handler{[](usc::ActiveOutputs const&){}};
+    usc::OutputsHandler outputs_handler{[](usc::Outputs const&){}};
 };
 
 struct AUnityDisplayService : testing::Test
@@ -67,11 +84,55 @@ struct AUnityDisplayService : testing::Test
     ut::UnityDisplayDBusClient client{bus.address()};
     std::shared_ptr<usc::DBusEventLoop> const dbus_loop =
         std::make_shared<usc::DBusEventLoop>();
-    usc::UnityDisplayService service{dbus_loop, bus.address(), fake_screen};
+    std::shared_ptr<usc::Tracer> const tracer{std::make_shared<usc::Tracer>()};
+    std::unique_ptr<usc::UnityDisplayService> service =
+        std::make_unique<usc::UnityDisplayService>(dbus_loop, bus.address(), fake_screen, tracer);
     std::shared_ptr<usc::DBusConnectionThread> const dbus_thread =
         std::make_shared<usc::DBusConnectionThread>(dbus_loop);
 };
 
+usc::ActiveOutputs active_outputs_from_properties_changed(DBusMessage* message)
+{
+    DBusMessageIter iter;
+    dbus_message_iter_init(message, &iter);
+    dbus_message_iter_next(&iter);
+    DBusMessageIter iter_properties;
+    dbus_message_iter_recurse(&iter, &iter_properties);
+    DBusMessageIter iter_property;
+    dbus_message_iter_recurse(&iter_properties, &iter_property);
+    dbus_message_iter_next(&iter_property);
+    DBusMessageIter iter_variant;
+    DBusMessageIter iter_values;
+    dbus_message_iter_recurse(&iter_property, &iter_variant);
+    dbus_message_iter_recurse(&iter_variant, &iter_values);
+
+    usc::ActiveOutputs active_outputs{-1, -1};
+    dbus_message_iter_get_basic(&iter_values, &active_outputs.internal);
+    dbus_message_iter_next(&iter_values);
+    dbus_message_iter_get_basic(&iter_values, &active_outputs.external);
+
+    return active_outputs;
+}
+
+struct PowerStateChange
+{
+    uint64_t transition;
+    bool on;
+};
+
+PowerStateChange power_state_change_from_signal(DBusMessage* message)
+{
+    dbus_uint64_t transition{0};
+    dbus_bool_t on{FALSE};
+    dbus_message_get_args(
+        message, nullptr,
+        DBUS_TYPE_UINT64, &transition,
+        DBUS_TYPE_BOOLEAN, &on,
+        DBUS_TYPE_INVALID);
+
+    return {transition, on == TRUE};
+}
+
 }
 
 TEST_F(AUnityDisplayService, replies_to_introspection_request)
@@ -227,3 +288,430 @@ TEST_F(AUnityDisplayService, returns_error_reply_for_unsupported_method)
     EXPECT_THAT(dbus_message_get_type(reply_msg), Eq(DBUS_MESSAGE_TYPE_ERROR));
     EXPECT_THAT(dbus_message_get_error_name(reply_msg), StrEq(DBUS_ERROR_FAILED));
 }
+
+TEST_F(AUnityDisplayService, does_not_emit_unchanged_active_outputs)
+{
+    using namespace testing;
+
+    usc::ActiveOutputs const active_outputs{1, 1};
+
+    fake_screen->notify_active_outputs(active_outputs);
+    auto message = client.listen_for_properties_changed();
+    EXPECT_THAT(active_outputs_from_properties_changed(message), Eq(active_outputs));
+
+    fake_screen->notify_active_outputs(active_outputs);
+    fake_screen->notify_active_outputs(active_outputs);
+
+    auto const window = usc::UnityDisplayService::default_active_outputs_window;
+    EXPECT_FALSE(client.listen_for_properties_changed(3 * window));
+}
+
+TEST_F(AUnityDisplayService, coalesces_active_outputs_changes_within_window)
+{
+    using namespace testing;
+
+    fake_screen->notify_active_outputs({1, 0});
+    auto first = client.listen_for_properties_changed();
+    EXPECT_THAT(active_outputs_from_properties_changed(first), Eq(usc::ActiveOutputs{1, 0}));
+
+    fake_screen->notify_active_outputs({1, 1});
+    fake_screen->notify_active_outputs({1, 2});
+    fake_screen->notify_active_outputs({1, 3});
+
+    auto const window = usc::UnityDisplayService::default_active_outputs_window;
+    auto second = client.listen_for_properties_changed(3 * window);
+    ASSERT_TRUE(second);
+    EXPECT_THAT(active_outputs_from_properties_changed(second), Eq(usc::ActiveOutputs{1, 3}));
+
+    EXPECT_FALSE(client.listen_for_properties_changed(3 * window));
+}
+
+TEST_F(AUnityDisplayService, does_not_emit_changes_reverted_within_window)
+{
+    using namespace testing;
+
+    fake_screen->notify_active_outputs({1, 0});
+    client.listen_for_properties_changed();
+
+    fake_screen->notify_active_outputs({1, 1});
+    fake_screen->notify_active_outputs({1, 0});
+
+    auto const window = usc::UnityDisplayService::default_active_outputs_window;
+    EXPECT_FALSE(client.listen_for_properties_changed(3 * window));
+}
+
+TEST_F(AUnityDisplayService, returns_updated_active_outputs_property_after_change)
+{
+    using namespace testing;
+
+    auto const active_outputs_property =
+        [this]
+        {
+            auto message = client.request_active_outputs_property().get();
+
+            DBusMessageIter iter;
+            dbus_message_iter_init(message, &iter);
+            DBusMessageIter iter_variant;
+            dbus_message_iter_recurse(&iter, &iter_variant);
+            DBusMessageIter iter_values;
+            dbus_message_iter_recurse(&iter_variant, &iter_values);
+
+            usc::ActiveOutputs active_outputs{-1, -1};
+            dbus_message_iter_get_basic(&iter_values, &active_outputs.internal);
+            dbus_message_iter_next(&iter_values);
+            dbus_message_iter_get_basic(&iter_values, &active_outputs.external);
+
+            return active_outputs;
+        };
+
+    fake_screen->notify_active_outputs({1, 0});
+    EXPECT_THAT(active_outputs_property(), Eq(usc::ActiveOutputs{1, 0}));
+    EXPECT_THAT(active_outputs_property(), Eq(usc::ActiveOutputs{1, 0}));
+
+    fake_screen->notify_active_outputs({1, 1});
+    EXPECT_THAT(active_outputs_property(), Eq(usc::ActiveOutputs{1, 1}));
+}
+
+TEST_F(AUnityDisplayService, forwards_turn_on_and_off_output_requests)
+{
+    using namespace testing;
+
+    fake_screen->notify_outputs({{1, usc::OutputType::internal, true, true, true},
+                                 {2, usc::OutputType::external, true, true, false}});
+
+    InSequence s;
+    EXPECT_CALL(*fake_screen, turn_on_output(2));
+    EXPECT_CALL(*fake_screen, turn_off_output(1));
+
+    client.request_turn_on_output(2).get();
+    client.request_turn_off_output(1).get();
+}
+
+TEST_F(AUnityDisplayService, replies_with_error_to_power_requests_for_unknown_outputs)
+{
+    using namespace testing;
+
+    fake_screen->notify_outputs({{1, usc::OutputType::internal, true, true, true}});
+
+    EXPECT_CALL(*fake_screen, turn_on_output(_)).Times(0);
+    EXPECT_CALL(*fake_screen, turn_off_output(_)).Times(0);
+
+    EXPECT_THROW({ client.request_turn_on_output(7).get(); }, std::runtime_error);
+    EXPECT_THROW({ client.request_turn_off_output(7).get(); }, std::runtime_error);
+}
+
+TEST_F(AUnityDisplayService, replies_with_error_to_malformed_output_power_requests)
+{
+    using namespace testing;
+
+    fake_screen->notify_outputs({{1, usc::OutputType::internal, true, true, true}});
+
+    EXPECT_CALL(*fake_screen, turn_on_output(_)).Times(0);
+    EXPECT_CALL(*fake_screen, turn_off_output(_)).Times(0);
+
+    auto const turn_on_reply = client.request_turn_on_output_with_malformed_id().get();
+    auto const turn_off_reply = client.request_turn_off_output_with_malformed_id().get();
+
+    EXPECT_THAT(dbus_message_get_error_name(turn_on_reply), StrEq(DBUS_ERROR_INVALID_ARGS));
+    EXPECT_THAT(dbus_message_get_error_name(turn_off_reply), StrEq(DBUS_ERROR_INVALID_ARGS));
+}
+
+TEST_F(AUnityDisplayService, returns_outputs_property)
+{
+    using namespace testing;
+
+    fake_screen->notify_outputs({{1, usc::OutputType::internal, true, true, true},
+                                 {4, usc::OutputType::external, true, true, false},
+                                 {5, usc::OutputType::external, false, false, false}});
+
+    auto message = client.request_outputs_property().get();
+
+    DBusMessageIter iter;
+    dbus_message_iter_init(message, &iter);
+    DBusMessageIter iter_variant;
+    dbus_message_iter_recurse(&iter, &iter_variant);
+    DBusMessageIter iter_array;
+    dbus_message_iter_recurse(&iter_variant, &iter_array);
+
+    std::vector<std::string> outputs;
+    for (; dbus_message_iter_get_arg_type(&iter_array) == DBUS_TYPE_STRUCT;
+         dbus_message_iter_next(&iter_array))
+    {
+        DBusMessageIter iter_struct;
+        dbus_message_iter_recurse(&iter_array, &iter_struct);
+
+        int32_t id{-1};
+        char const* type{""};
+        dbus_bool_t connected{FALSE};
+        dbus_bool_t on{FALSE};
+
+        dbus_message_iter_get_basic(&iter_struct, &id);
+        dbus_message_iter_next(&iter_struct);
+        dbus_message_iter_get_basic(&iter_struct, &type);
+        dbus_message_iter_next(&iter_struct);
+        dbus_message_iter_get_basic(&iter_struct, &connected);
+        dbus_message_iter_next(&iter_struct);
+        dbus_message_iter_get_basic(&iter_struct, &on);
+
+        outputs.push_back(
+            std::to_string(id) + " " + type +
+            (connected ? " connected" : " disconnected") +
+            (on ? " on" : " off"));
+    }
+
+    EXPECT_THAT(outputs, ElementsAre(
+        "1 internal connected on",
+        "4 external connected off",
+        "5 external disconnected off"));
+}
+
+TEST_F(AUnityDisplayService, replies_to_turn_on_before_the_screen_has_turned_on)
+{
+    using namespace testing;
+
+    ut::WaitCondition screen_turned_on;
+    ut::WaitCondition release_screen;
+
+    EXPECT_CALL(*fake_screen, turn_on(usc::OutputFilter::all))
+        .WillOnce(DoAll(WaitFor(&release_screen, std::chrono::seconds{5}),
+                        WakeUp(&screen_turned_on)));
+
+    client.request_turn_on("all").get();
+    EXPECT_FALSE(screen_turned_on.woken());
+
+    release_screen.wake_up();
+    screen_turned_on.wait_for(std::chrono::seconds{5});
+    EXPECT_TRUE(screen_turned_on.woken());
+}
+
+TEST_F(AUnityDisplayService, emits_power_state_changed_once_transition_completes)
+{
+    using namespace testing;
+
+    ut::WaitCondition screen_turned_off;
+
+    EXPECT_CALL(*fake_screen, turn_off(usc::OutputFilter::internal))
+        .WillOnce(WakeUp(&screen_turned_off));
+
+    auto const transition = client.request_turn_off("internal").get();
+    auto const message = client.listen_for_power_state_changed();
+    auto const change = power_state_change_from_signal(message);
+
+    EXPECT_TRUE(screen_turned_off.woken());
+    EXPECT_THAT(change.transition, Eq(transition));
+    EXPECT_FALSE(change.on);
+}
+
+TEST_F(AUnityDisplayService, returns_trace_of_power_transition_stages)
+{
+    using namespace testing;
+
+    auto const transition = client.request_turn_on("all").get();
+    client.listen_for_power_state_changed();
+
+    auto const trace = client.request_wake_trace().get();
+    auto const transition_args =
+        R"("args":{"transition":)" + std::to_string(transition) + "}";
+
+    std::string::size_type pos = 0;
+    for (auto const point : {"turn_on_requested",
+                             "power_transition_started",
+                             "power_transition_completed",
+                             "power_state_changed_sent"})
+    {
+        pos = trace.find(std::string{R"("name":")"} + point + '"', pos);
+        ASSERT_THAT(pos, Ne(std::string::npos)) << point;
+        EXPECT_THAT(trace.substr(pos, trace.find('}', pos) + 1 - pos),
+                    HasSubstr(transition_args)) << point;
+    }
+}
+
+TEST_F(AUnityDisplayService, links_power_request_to_the_key_press_causing_it)
+{
+    using namespace testing;
+
+    auto const cause = tracer->trace_cause("power_key_down");
+    auto const transition = client.request_turn_on("all").get();
+    auto const later_transition = client.request_turn_off("all").get();
+
+    auto const trace = client.request_wake_trace().get();
+
+    EXPECT_THAT(trace, HasSubstr(
+        R"("args":{"transition":)" + std::to_string(transition) +
+        R"(,"cause":)" + std::to_string(cause) + "}"));
+    EXPECT_THAT(trace, Not(HasSubstr(
+        R"("args":{"transition":)" + std::to_string(later_transition) + R"(,"cause":)")));
+}
+
+TEST_F(AUnityDisplayService, returns_statistics_of_its_loop)
+{
+    using namespace testing;
+
+    client.request_turn_on("all").get();
+
+    auto const statistics = client.request_loop_statistics().get();
+
+    EXPECT_THAT(statistics, StartsWith(R"({"action_latency_us":{"samples":)"));
+    EXPECT_THAT(statistics, HasSubstr(R"("handler_run_time_us":{"samples":)"));
+    EXPECT_THAT(statistics, HasSubstr(R"("wake_ups_per_second":{"samples":)"));
+    EXPECT_THAT(statistics, HasSubstr(R"("stalled_iterations":0)"));
+    EXPECT_THAT(statistics, HasSubstr(R"("coalesced_wake_ups":)"));
+    // The turn on request was handled on the loop
+    EXPECT_THAT(statistics, Not(HasSubstr(R"("handler_run_time_us":{"samples":0,)")));
+}
+
+TEST_F(AUnityDisplayService, completes_power_transitions_in_request_order)
+{
+    using namespace testing;
+
+    fake_screen->notify_outputs({{1, usc::OutputType::internal, true, true, true}});
+
+    auto const first = client.request_turn_on("all").get();
+    auto const second = client.request_turn_off_output(1).get();
+    // Not for the same outputs as the request before, so that it can't
+    // take over if that one is still waiting
+    auto const third = client.request_turn_on("internal").get();
+
+    EXPECT_THAT(first, Ne(second));
+    EXPECT_THAT(second, Ne(third));
+
+    std::vector<uint64_t> completed;
+    std::vector<bool> power_states;
+    for (int i = 0; i < 3; ++i)
+    {
+        auto const change = power_state_change_from_signal(
+            client.listen_for_power_state_changed());
+        completed.push_back(change.transition);
+        power_states.push_back(change.on);
+    }
+
+    EXPECT_THAT(completed, ElementsAre(first, second, third));
+    EXPECT_THAT(power_states, ElementsAre(true, false, true));
+}
+
+TEST_F(AUnityDisplayService, merges_repeated_power_request_into_transition_in_progress)
+{
+    using namespace testing;
+
+    ut::WaitCondition release_screen;
+
+    EXPECT_CALL(*fake_screen, turn_on(usc::OutputFilter::all))
+        .WillOnce(WaitFor(&release_screen, std::chrono::seconds{5}));
+
+    auto const first = client.request_turn_on("all").get();
+    auto const second = client.request_turn_on("all").get();
+
+    EXPECT_THAT(second, Eq(first));
+
+    release_screen.wake_up();
+    auto const change = power_state_change_from_signal(
+        client.listen_for_power_state_changed());
+    EXPECT_THAT(change.transition, Eq(first));
+}
+
+TEST_F(AUnityDisplayService, collapses_power_requests_made_while_the_screen_is_busy)
+{
+    using namespace testing;
+
+    ut::WaitCondition screen_busy;
+    ut::WaitCondition release_screen;
+
+    EXPECT_CALL(*fake_screen, turn_on(usc::OutputFilter::all))
+        .WillOnce(DoAll(WakeUp(&screen_busy),
+                        WaitFor(&release_screen, std::chrono::seconds{5})));
+    EXPECT_CALL(*fake_screen, turn_off(usc::OutputFilter::all))
+        .Times(1);
+
+    auto const first = client.request_turn_on("all").get();
+    screen_busy.wait_for(std::chrono::seconds{5});
+
+    // Each of these takes over the one before while the screen is busy,
+    // so only the last one is applied
+    auto const second = client.request_turn_off("all").get();
+    auto const third = client.request_turn_on("all").get();
+    auto const fourth = client.request_turn_off("all").get();
+
+    release_screen.wake_up();
+
+    std::vector<uint64_t> completed;
+    std::vector<bool> power_states;
+    for (int i = 0; i < 4; ++i)
+    {
+        auto const change = power_state_change_from_signal(
+            client.listen_for_power_state_changed());
+        completed.push_back(change.transition);
+        power_states.push_back(change.on);
+    }
+
+    EXPECT_THAT(completed, ElementsAre(first, second, third, fourth));
+    EXPECT_THAT(power_states, ElementsAre(true, false, false, false));
+}
+
+TEST_F(AUnityDisplayService, can_be_destroyed_while_a_power_transition_is_in_progress)
+{
+    using namespace testing;
+
+    ut::WaitCondition screen_busy;
+    ut::WaitCondition release_screen;
+
+    InSequence s;
+    EXPECT_CALL(*fake_screen, turn_on(usc::OutputFilter::all))
+        .WillOnce(DoAll(WakeUp(&screen_busy),
+                        WaitFor(&release_screen, std::chrono::seconds{5})));
+    // Requested transitions are still carried out
+    EXPECT_CALL(*fake_screen, turn_off(usc::OutputFilter::all));
+
+    client.request_turn_on("all").get();
+    screen_busy.wait_for(std::chrono::seconds{5});
+    client.request_turn_off("all").get();
+
+    // The loop keeps running, so the completion of the transition in
+    // progress races with the destruction
+    auto const destroyed = std::async(std::launch::async, [this] { service.reset(); });
+
+    release_screen.wake_up();
+
+    EXPECT_EQ(std::future_status::ready, destroyed.wait_for(std::chrono::seconds{5}));
+
+    std::promise<void> drained;
+    dbus_loop->enqueue(usc::DBusEventLoop::Priority::high, [&] { drained.set_value(); });
+    drained.get_future().wait();
+}
+
+TEST_F(AUnityDisplayService, rejects_power_requests_while_too_many_are_in_progress)
+{
+    using namespace testing;
+
+    ut::WaitCondition release_screen;
+
+    EXPECT_CALL(*fake_screen, turn_on(usc::OutputFilter::all))
+        .WillOnce(WaitFor(&release_screen, std::chrono::seconds{5}))
+        .WillRepeatedly(Return());
+
+    // Alternate, so that the requests can't be merged
+    for (unsigned int i = 0; i < usc::UnityDisplayService::max_pending_transitions; ++i)
+    {
+        if (i % 2 == 0)
+            client.request_turn_on("all").get();
+        else
+            client.request_turn_off("all").get();
+    }
+
+    int rejected{0};
+
+    for (int i = 0; i < 4; ++i)
+    {
+        try
+        {
+            client.request_turn_on("external").get();
+        }
+        catch (std::runtime_error const&)
+        {
+            ++rejected;
+        }
+    }
+
+    release_screen.wake_up();
+
+    EXPECT_THAT(rejected, Eq(4));
+}
@@ -31,7 +31,9 @@
 #include "usc/test/mock_input_configuration.h"
 
 #include <stdexcept>
+#include <map>
 #include <memory>
+#include <string>
 
 namespace ut = usc::test;
 
@@ -153,3 +155,153 @@ TEST_F(AUnityInputService, forwards_set_touchpad_tap_to_click)
     client.request_set_touchpad_tap_to_click(enable_it);
 }
 
+
+TEST_F(AUnityInputService, applies_subset_of_settings_in_one_go)
+{
+    using namespace testing;
+
+    usc::InputSettings const current{0, 0.5, 1.0, 0, 0.5, 1.0, true, true, false, false};
+    auto expected = current;
+    expected.mouse_cursor_speed = 0.8;
+    expected.tap_to_click = false;
+
+    ON_CALL(*mock_input_configuration, settings()).WillByDefault(Return(current));
+    EXPECT_CALL(*mock_input_configuration, apply_settings(expected));
+    EXPECT_CALL(*mock_input_configuration, set_mouse_cursor_speed(_)).Times(0);
+    EXPECT_CALL(*mock_input_configuration, set_tap_to_click(_)).Times(0);
+
+    double const speed{0.8};
+    dbus_bool_t const tap_to_click{FALSE};
+
+    client.request_apply_settings(
+        {{"MouseCursorSpeed", DBUS_TYPE_DOUBLE, &speed},
+         {"TouchpadTapToClick", DBUS_TYPE_BOOLEAN, &tap_to_click}}).get();
+}
+
+TEST_F(AUnityInputService, applies_no_settings_if_any_is_invalid)
+{
+    using namespace testing;
+
+    EXPECT_CALL(*mock_input_configuration, apply_settings(_)).Times(0);
+
+    double const speed{0.8};
+    int32_t const not_a_bool{1};
+    char const* const unknown{"unknown"};
+
+    EXPECT_THROW({
+        client.request_apply_settings(
+            {{"MouseCursorSpeed", DBUS_TYPE_DOUBLE, &speed},
+             {"TouchpadTapToClick", DBUS_TYPE_INT32, &not_a_bool}}).get();
+    }, std::runtime_error);
+
+    EXPECT_THROW({
+        client.request_apply_settings(
+            {{"MouseCursorSpeed", DBUS_TYPE_DOUBLE, &speed},
+             {"NoSuchSetting", DBUS_TYPE_STRING, &unknown}}).get();
+    }, std::runtime_error);
+}
+
+TEST_F(AUnityInputService, replies_with_current_settings)
+{
+    using namespace testing;
+
+    usc::InputSettings const current{1, 0.25, 2.0, 0, 0.75, 1.5, true, false, true, false};
+    ON_CALL(*mock_input_configuration, settings()).WillByDefault(Return(current));
+
+    auto reply = client.request_get_settings().get();
+
+    DBusMessageIter iter;
+    dbus_message_iter_init(reply, &iter);
+    DBusMessageIter iter_dict;
+    dbus_message_iter_recurse(&iter, &iter_dict);
+
+    std::map<std::string, std::string> settings;
+    for (; dbus_message_iter_get_arg_type(&iter_dict) == DBUS_TYPE_DICT_ENTRY;
+         dbus_message_iter_next(&iter_dict))
+    {
+        DBusMessageIter iter_entry;
+        dbus_message_iter_recurse(&iter_dict, &iter_entry);
+        char const* key{""};
+        dbus_message_iter_get_basic(&iter_entry, &key);
+        dbus_message_iter_next(&iter_entry);
+
+        DBusMessageIter iter_variant;
+        dbus_message_iter_recurse(&iter_entry, &iter_variant);
+
+        switch (dbus_message_iter_get_arg_type(&iter_variant))
+        {
+        case DBUS_TYPE_INT32:
+        {
+            int32_t value{-1};
+            dbus_message_iter_get_basic(&iter_variant, &value);
+            settings[key] = std::to_string(value);
+            break;
+        }
+        case DBUS_TYPE_DOUBLE:
+        {
+            double value{-1.0};
+            dbus_message_iter_get_basic(&iter_variant, &value);
+            settings[key] = std::to_string(value);
+            break;
+        }
+        case DBUS_TYPE_BOOLEAN:
+        {
+            dbus_bool_t value{FALSE};
+            dbus_message_iter_get_basic(&iter_variant, &value);
+            settings[key] = value ? "true" : "false";
+            break;
+        }
+        }
+    }
+
+    EXPECT_THAT(settings, ContainerEq(std::map<std::string, std::string>{
+        {"MousePrimaryButton", "1"},
+        {"MouseCursorSpeed", std::to_string(0.25)},
+        {"MouseScrollSpeed", std::to_string(2.0)},
+        {"TouchpadPrimaryButton", "0"},
+        {"TouchpadCursorSpeed", std::to_string(0.75)},
+        {"TouchpadScrollSpeed", std::to_string(1.5)},
+        {"TouchpadTwoFingerScroll", "true"},
+        {"TouchpadTapToClick", "false"},
+        {"TouchpadDisableWhileTyping", "true"},
+        {"TouchpadDisableWithMouse", "false"}}));
+}
+
+TEST_F(AUnityInputService, rejects_calls_beyond_the_rate_limit_of_a_client)
+{
+    using namespace testing;
+
+    int const calls = 2 * usc::RateLimiter::default_burst;
+    int rejected{0};
+
+    for (int i = 0; i < calls; ++i)
+    {
+        try
+        {
+            client.request_set_mouse_scroll_speed(1.0).get();
+        }
+        catch (std::runtime_error const&)
+        {
+            ++rejected;
+        }
+    }
+
+    EXPECT_THAT(rejected, Gt(0));
+    EXPECT_THAT(rejected, Lt(calls));
+}
+
+TEST_F(AUnityInputService, limits_the_rate_of_each_client_separately)
+{
+    using namespace testing;
+
+    for (unsigned int i = 0; i < 2 * usc::RateLimiter::default_burst; ++i)
+    {
+        try { client.request_set_mouse_scroll_speed(1.0).get(); }
+        catch (std::runtime_error const&) {}
+    }
+
+    ut::UnityInputDBusClient other_client{bus.address()};
+
+    EXPECT_CALL(*mock_input_configuration, set_mouse_scroll_speed(2.0));
+    EXPECT_NO_THROW({ other_client.request_set_mouse_scroll_speed(2.0).get(); });
+}
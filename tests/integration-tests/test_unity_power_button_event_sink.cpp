@@ -16,13 +16,18 @@
 
 #include "src/unity_power_button_event_sink.h"
 #include "src/dbus_connection_handle.h"
+#include "src/dbus_connection_thread.h"
+#include "src/dbus_event_loop.h"
 #include "src/dbus_message_handle.h"
+#include "src/tracer.h"
 
 #include "dbus_bus.h"
 
 #include <gtest/gtest.h>
+#include <gmock/gmock.h>
 
 #include <future>
+#include <memory>
 
 namespace ut = usc::test;
 
@@ -45,7 +50,9 @@ struct AUnityPowerButtonEventSink : testing::Test
             dbus_connection_read_write(connection, 1);
             auto msg = usc::DBusMessageHandle{dbus_connection_pop_message(connection)};
 
-            if (msg && dbus_message_is_signal(msg, unity_power_button_iface, name))
+            // A null name matches any power button signal
+            if (msg && (name ? dbus_message_is_signal(msg, unity_power_button_iface, name) :
+                               dbus_message_has_interface(msg, unity_power_button_iface)))
             {
                 return msg;
             }
@@ -54,7 +61,14 @@ struct AUnityPowerButtonEventSink : testing::Test
     }
 
     ut::DBusBus bus;
-    usc::UnityPowerButtonEventSink sink{bus.address()};
+    std::shared_ptr<usc::DBusEventLoop> const dbus_loop{std::make_shared<usc::DBusEventLoop>()};
+    // Outlives the sink, as when the services share it
+    std::shared_ptr<usc::DBusConnectionHandle> const sink_connection{
+        std::make_shared<usc::DBusConnectionHandle>(bus.address())};
+    std::shared_ptr<usc::Tracer> const tracer{std::make_shared<usc::Tracer>()};
+    std::unique_ptr<usc::UnityPowerButtonEventSink> sink{
+        std::make_unique<usc::UnityPowerButtonEventSink>(dbus_loop, sink_connection, tracer)};
+    usc::DBusConnectionThread const dbus_thread{dbus_loop};
     usc::DBusConnectionHandle connection{bus.address().c_str()};
 
     char const* const unity_power_button_iface = "com.canonical.Unity.PowerButton";
@@ -67,17 +81,97 @@ TEST_F(AUnityPowerButtonEventSink, sends_press_signal)
      auto async_message = std::async(std::launch::async,
         [&] { return listen_for_power_button_signal("Press"); });
 
-    sink.notify_press();
+    sink->notify_press();
 
     async_message.get();         
 }
 
+TEST_F(AUnityPowerButtonEventSink, traces_press_signal_with_cause_of_key_press)
+{
+    using namespace testing;
+
+    auto const cause = tracer->trace_cause("power_key_down");
+
+    sink->notify_press();
+    listen_for_power_button_signal("Press");
+
+    auto const trace = tracer->chrome_trace_json();
+    auto const pos = trace.find(R"("name":"power_button_press_signal")");
+
+    ASSERT_THAT(pos, Ne(std::string::npos));
+    EXPECT_THAT(trace.substr(pos, trace.find("}}", pos) - pos),
+                HasSubstr(R"("cause":)" + std::to_string(cause)));
+}
+
 TEST_F(AUnityPowerButtonEventSink, sends_release_signal)
 {
      auto async_message = std::async(std::launch::async,
         [&] { return listen_for_power_button_signal("Release"); });
 
-    sink.notify_release();
+    sink->notify_release();
 
     async_message.get();         
 }
+
+TEST_F(AUnityPowerButtonEventSink, does_not_drop_queued_signals)
+{
+    int const presses{3};
+
+    // Keep the loop busy while the button is pressed
+    std::promise<void> unblock;
+    auto unblocked = unblock.get_future();
+    dbus_loop->enqueue([&] { unblocked.wait(); });
+
+    for (int i = 0; i < presses; ++i)
+        sink->notify_press();
+    sink->notify_release();
+
+    auto async_count = std::async(std::launch::async,
+        [&]
+        {
+            int press_signals{0};
+            while (dbus_message_is_signal(
+                       listen_for_power_button_signal(nullptr),
+                       unity_power_button_iface, "Press"))
+            {
+                ++press_signals;
+            }
+            return press_signals;
+        });
+
+    unblock.set_value();
+
+    EXPECT_EQ(presses, async_count.get());
+}
+
+TEST_F(AUnityPowerButtonEventSink, drops_signals_still_queued_when_destroyed)
+{
+    // Keep the loop busy while the button is pressed. Signals are queued at high
+    // priority, so only a high priority action that has started holds
+    // them up.
+    std::promise<void> blocked;
+    std::promise<void> unblock;
+    auto unblocked = unblock.get_future();
+    dbus_loop->enqueue(
+        usc::DBusEventLoop::Priority::high,
+        [&] { blocked.set_value(); unblocked.wait(); });
+    blocked.get_future().wait();
+
+    sink->notify_press();
+    sink.reset();
+
+    std::promise<void> drained;
+    dbus_loop->enqueue([&] { drained.set_value(); });
+    unblock.set_value();
+    drained.get_future().wait();
+
+    // Sent by us after the loop has run the queued signal, if any
+    usc::DBusMessageHandle marker{
+        dbus_message_new_signal(
+            "/com/canonical/Unity/PowerButton", unity_power_button_iface, "Marker")};
+    dbus_connection_send(connection, marker, nullptr);
+    dbus_connection_flush(connection);
+
+    EXPECT_TRUE(dbus_message_is_signal(
+        listen_for_power_button_signal(nullptr), unity_power_button_iface, "Marker"));
+}
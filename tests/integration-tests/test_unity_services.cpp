@@ -21,6 +21,7 @@
 #include "src/dbus_event_loop.h"
 #include "src/dbus_message_handle.h"
 #include "src/unity_display_service.h"
+#include "src/tracer.h"
 #include "src/unity_input_service_introspection.h"
 #include "src/unity_display_service_introspection.h"
 
@@ -52,12 +53,35 @@ struct UnityServices : testing::Test
         std::make_shared<testing::NiceMock<ut::MockInputConfiguration>>();
     std::shared_ptr<usc::DBusEventLoop> const dbus_loop=
         std::make_shared<usc::DBusEventLoop>();
-    usc::UnityDisplayService screen_service{dbus_loop, bus.address(), mock_screen};
+    usc::UnityDisplayService screen_service{
+        dbus_loop, bus.address(), mock_screen, std::make_shared<usc::Tracer>()};
     usc::UnityInputService input_service{dbus_loop, bus.address(), mock_input_configuration};
     std::shared_ptr<usc::DBusConnectionThread> const dbus_thread =
         std::make_shared<usc::DBusConnectionThread>(dbus_loop);
 };
 
+struct UnityServicesOnSharedConnection : testing::Test
+{
+    std::chrono::seconds const default_timeout{3};
+    ut::DBusBus bus;
+
+    ut::UnityDisplayDBusClient screen_client{bus.address()};
+    ut::UnityInputDBusClient input_client{bus.address()};
+    std::shared_ptr<ut::MockScreen> const mock_screen =
+        std::make_shared<testing::NiceMock<ut::MockScreen>>();
+    std::shared_ptr<ut::MockInputConfiguration> const mock_input_configuration =
+        std::make_shared<testing::NiceMock<ut::MockInputConfiguration>>();
+    std::shared_ptr<usc::DBusEventLoop> const dbus_loop=
+        std::make_shared<usc::DBusEventLoop>();
+    std::shared_ptr<usc::DBusConnectionHandle> const connection =
+        std::make_shared<usc::DBusConnectionHandle>(bus.address());
+    usc::UnityDisplayService screen_service{
+        dbus_loop, connection, mock_screen, std::make_shared<usc::Tracer>()};
+    usc::UnityInputService input_service{dbus_loop, connection, mock_input_configuration};
+    std::shared_ptr<usc::DBusConnectionThread> const dbus_thread =
+        std::make_shared<usc::DBusConnectionThread>(dbus_loop);
+};
+
 }
 
 TEST_F(UnityServices, offer_display_introspection)
@@ -80,3 +104,23 @@ TEST_F(UnityServices, provides_access_to_input_methods)
 
     input_client.request_set_mouse_scroll_speed(speed);
 }
+
+TEST_F(UnityServicesOnSharedConnection, route_introspection_by_object_path)
+{
+    auto display_reply = screen_client.request_introspection();
+    auto input_reply = input_client.request_introspection();
+
+    EXPECT_THAT(display_reply.get(), Eq(unity_display_service_introspection));
+    EXPECT_THAT(input_reply.get(), Eq(unity_input_service_introspection));
+}
+
+TEST_F(UnityServicesOnSharedConnection, provide_access_to_display_and_input_methods)
+{
+    double const speed = 8.0;
+
+    EXPECT_CALL(*mock_screen, turn_on(usc::OutputFilter::all));
+    EXPECT_CALL(*mock_input_configuration, set_mouse_scroll_speed(speed));
+
+    screen_client.request_turn_on("all");
+    input_client.request_set_mouse_scroll_speed(speed);
+}
@@ -17,6 +17,8 @@
 #include "src/unity_user_activity_event_sink.h"
 #include "src/unity_user_activity_type.h"
 #include "src/dbus_connection_handle.h"
+#include "src/dbus_connection_thread.h"
+#include "src/dbus_event_loop.h"
 #include "src/dbus_message_handle.h"
 
 #include "dbus_bus.h"
@@ -24,6 +26,7 @@
 #include <gtest/gtest.h>
 
 #include <future>
+#include <memory>
 
 namespace ut = usc::test;
 
@@ -55,7 +58,10 @@ struct AUnityUserActivityEventSink : testing::Test
     }
 
     ut::DBusBus bus;
-    usc::UnityUserActivityEventSink sink{bus.address()};
+    std::shared_ptr<usc::DBusEventLoop> const dbus_loop{std::make_shared<usc::DBusEventLoop>()};
+    std::unique_ptr<usc::UnityUserActivityEventSink> sink{
+        std::make_unique<usc::UnityUserActivityEventSink>(dbus_loop, bus.address())};
+    usc::DBusConnectionThread const dbus_thread{dbus_loop};
     usc::DBusConnectionHandle connection{bus.address().c_str()};
 
     char const* const unity_power_button_iface = "com.canonical.Unity.UserActivity";
@@ -68,7 +74,7 @@ TEST_F(AUnityUserActivityEventSink, sends_activity_changing_power_state_signal)
      auto async_message = std::async(std::launch::async,
         [&] { return listen_for_user_activity_signal(); });
 
-    sink.notify_activity_changing_power_state();
+    sink->notify_activity_changing_power_state();
 
     auto message = async_message.get();         
 
@@ -85,7 +91,7 @@ TEST_F(AUnityUserActivityEventSink, sends_activity_extending_power_state_signal)
      auto async_message = std::async(std::launch::async,
         [&] { return listen_for_user_activity_signal(); });
 
-    sink.notify_activity_extending_power_state();
+    sink->notify_activity_extending_power_state();
 
     auto message = async_message.get();         
 
@@ -97,3 +103,74 @@ TEST_F(AUnityUserActivityEventSink, sends_activity_extending_power_state_signal)
     EXPECT_EQ(static_cast<int32_t>(usc::UnityUserActivityType::extending_power_state), type);
 }
 
+
+TEST_F(AUnityUserActivityEventSink, merges_queued_signals_of_the_same_type)
+{
+    auto const activity_type_of =
+        [] (usc::DBusMessageHandle const& message)
+        {
+            int32_t type{-1};
+            dbus_message_get_args(message, nullptr,
+                DBUS_TYPE_INT32, &type,
+                DBUS_TYPE_INVALID);
+            return type;
+        };
+
+    int32_t const changing_power_state =
+        static_cast<int32_t>(usc::UnityUserActivityType::changing_power_state);
+
+    // Keep the loop busy while activity is reported
+    std::promise<void> unblock;
+    auto unblocked = unblock.get_future();
+    dbus_loop->enqueue([&] { unblocked.wait(); });
+
+    for (int i = 0; i < 5; ++i)
+        sink->notify_activity_extending_power_state();
+    sink->notify_activity_changing_power_state();
+
+    auto async_count = std::async(std::launch::async,
+        [&]
+        {
+            int extending_signals{0};
+            while (activity_type_of(listen_for_user_activity_signal()) != changing_power_state)
+                ++extending_signals;
+            return extending_signals;
+        });
+
+    unblock.set_value();
+
+    EXPECT_EQ(1, async_count.get());
+}
+
+TEST_F(AUnityUserActivityEventSink, drops_signals_still_queued_when_destroyed)
+{
+    // Keep the loop busy while activity is reported
+    std::promise<void> unblock;
+    auto unblocked = unblock.get_future();
+    dbus_loop->enqueue([&] { unblocked.wait(); });
+
+    sink->notify_activity_changing_power_state();
+    sink.reset();
+
+    std::promise<void> drained;
+    dbus_loop->enqueue([&] { drained.set_value(); });
+    unblock.set_value();
+    drained.get_future().wait();
+
+    // Sent by us after the loop has run the queued signal, if any
+    int32_t const marker_type{-1};
+    usc::DBusMessageHandle marker{
+        dbus_message_new_signal(
+            "/com/canonical/Unity/UserActivity", unity_power_button_iface, "Activity"),
+        DBUS_TYPE_INT32, &marker_type,
+        DBUS_TYPE_INVALID};
+    dbus_connection_send(connection, marker, nullptr);
+    dbus_connection_flush(connection);
+
+    int32_t type{0};
+    dbus_message_get_args(listen_for_user_activity_signal(), nullptr,
+        DBUS_TYPE_INT32, &type,
+        DBUS_TYPE_INVALID);
+
+    EXPECT_EQ(marker_type, type);
+}
@@ -30,6 +30,9 @@ ut::UnityDisplayDBusClient::UnityDisplayDBusClient(std::string const& address)
         connection.add_match(
             "type='signal',"
             "interface='org.freedesktop.DBus.Properties'");
+        connection.add_match(
+            "type='signal',"
+            "interface='com.canonical.Unity.Display'");
 }
 
 ut::DBusAsyncReplyString ut::UnityDisplayDBusClient::request_introspection()
@@ -39,23 +42,23 @@ ut::DBusAsyncReplyString ut::UnityDisplayDBusClient::request_introspection()
         DBUS_TYPE_INVALID);
 }
 
-ut::DBusAsyncReplyVoid ut::UnityDisplayDBusClient::request_turn_on(
+ut::DBusAsyncReplyUInt64 ut::UnityDisplayDBusClient::request_turn_on(
     std::string const& filter)
 {
     auto const filter_cstr = filter.c_str();
 
-    return invoke_with_reply<ut::DBusAsyncReplyVoid>(
+    return invoke_with_reply<ut::DBusAsyncReplyUInt64>(
         unity_display_interface, "TurnOn",
         DBUS_TYPE_STRING, &filter_cstr,
         DBUS_TYPE_INVALID);
 }
 
-ut::DBusAsyncReplyVoid ut::UnityDisplayDBusClient::request_turn_off(
+ut::DBusAsyncReplyUInt64 ut::UnityDisplayDBusClient::request_turn_off(
     std::string const& filter)
 {
     auto const filter_cstr = filter.c_str();
 
-    return invoke_with_reply<ut::DBusAsyncReplyVoid>(
+    return invoke_with_reply<ut::DBusAsyncReplyUInt64>(
         unity_display_interface, "TurnOff",
         DBUS_TYPE_STRING, &filter_cstr,
         DBUS_TYPE_INVALID);
@@ -67,6 +70,56 @@ ut::DBusAsyncReply ut::UnityDisplayDBusClient::request_invalid_method()
         unity_display_interface, "invalidMethod", DBUS_TYPE_INVALID);
 }
 
+ut::DBusAsyncReplyUInt64 ut::UnityDisplayDBusClient::request_turn_on_output(int32_t id)
+{
+    return invoke_with_reply<ut::DBusAsyncReplyUInt64>(
+        unity_display_interface, "TurnOnOutput",
+        DBUS_TYPE_INT32, &id,
+        DBUS_TYPE_INVALID);
+}
+
+ut::DBusAsyncReplyUInt64 ut::UnityDisplayDBusClient::request_turn_off_output(int32_t id)
+{
+    return invoke_with_reply<ut::DBusAsyncReplyUInt64>(
+        unity_display_interface, "TurnOffOutput",
+        DBUS_TYPE_INT32, &id,
+        DBUS_TYPE_INVALID);
+}
+
+ut::DBusAsyncReply ut::UnityDisplayDBusClient::request_turn_on_output_with_malformed_id()
+{
+    char const* const id = "1";
+
+    return invoke_with_reply<ut::DBusAsyncReply>(
+        unity_display_interface, "TurnOnOutput",
+        DBUS_TYPE_STRING, &id,
+        DBUS_TYPE_INVALID);
+}
+
+ut::DBusAsyncReply ut::UnityDisplayDBusClient::request_turn_off_output_with_malformed_id()
+{
+    char const* const id = "1";
+
+    return invoke_with_reply<ut::DBusAsyncReply>(
+        unity_display_interface, "TurnOffOutput",
+        DBUS_TYPE_STRING, &id,
+        DBUS_TYPE_INVALID);
+}
+
+ut::DBusAsyncReplyString ut::UnityDisplayDBusClient::request_wake_trace()
+{
+    return invoke_with_reply<ut::DBusAsyncReplyString>(
+        unity_display_interface, "GetWakeTrace",
+        DBUS_TYPE_INVALID);
+}
+
+ut::DBusAsyncReplyString ut::UnityDisplayDBusClient::request_loop_statistics()
+{
+    return invoke_with_reply<ut::DBusAsyncReplyString>(
+        unity_display_interface, "GetLoopStatistics",
+        DBUS_TYPE_INVALID);
+}
+
 ut::DBusAsyncReply ut::UnityDisplayDBusClient::request_active_outputs_property()
 {
     char const* const active_outputs_cstr = "ActiveOutputs";
@@ -78,6 +131,17 @@ ut::DBusAsyncReply ut::UnityDisplayDBusClient::request_active_outputs_property()
         DBUS_TYPE_INVALID);
 }
 
+ut::DBusAsyncReply ut::UnityDisplayDBusClient::request_outputs_property()
+{
+    char const* const outputs_cstr = "Outputs";
+
+    return invoke_with_reply<ut::DBusAsyncReply>(
+        "org.freedesktop.DBus.Properties", "Get",
+        DBUS_TYPE_STRING, &unity_display_interface,
+        DBUS_TYPE_STRING, &outputs_cstr,
+        DBUS_TYPE_INVALID);
+}
+
 ut::DBusAsyncReply ut::UnityDisplayDBusClient::request_all_properties()
 {
     return invoke_with_reply<ut::DBusAsyncReply>(
@@ -99,3 +163,36 @@ usc::DBusMessageHandle ut::UnityDisplayDBusClient::listen_for_properties_changed
         }
     }
 }
+
+usc::DBusMessageHandle ut::UnityDisplayDBusClient::listen_for_properties_changed(
+    std::chrono::milliseconds timeout)
+{
+    auto const deadline = std::chrono::steady_clock::now() + timeout;
+
+    while (std::chrono::steady_clock::now() < deadline)
+    {
+        dbus_connection_read_write(connection, 1);
+        auto msg = usc::DBusMessageHandle{dbus_connection_pop_message(connection)};
+
+        if (msg && dbus_message_is_signal(msg, "org.freedesktop.DBus.Properties", "PropertiesChanged"))
+        {
+            return msg;
+        }
+    }
+
+    return usc::DBusMessageHandle{nullptr};
+}
+
+usc::DBusMessageHandle ut::UnityDisplayDBusClient::listen_for_power_state_changed()
+{
+    while (true)
+    {
+        dbus_connection_read_write(connection, 1);
+        auto msg = usc::DBusMessageHandle{dbus_connection_pop_message(connection)};
+
+        if (msg && dbus_message_is_signal(msg, unity_display_interface, "PowerStateChanged"))
+        {
+            return msg;
+        }
+    }
+}
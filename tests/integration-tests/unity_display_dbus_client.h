@@ -21,6 +21,8 @@
 
 #include "dbus_client.h"
 
+#include <chrono>
+
 namespace usc
 {
 namespace test
@@ -32,13 +34,23 @@ public:
     UnityDisplayDBusClient(std::string const& address);
 
     DBusAsyncReplyString request_introspection();
-    DBusAsyncReplyVoid request_turn_on(std::string const& filter);
-    DBusAsyncReplyVoid request_turn_off(std::string const& filter);
+    DBusAsyncReplyUInt64 request_turn_on(std::string const& filter);
+    DBusAsyncReplyUInt64 request_turn_off(std::string const& filter);
+    DBusAsyncReplyUInt64 request_turn_on_output(int32_t id);
+    DBusAsyncReplyUInt64 request_turn_off_output(int32_t id);
+    DBusAsyncReply request_turn_on_output_with_malformed_id();
+    DBusAsyncReply request_turn_off_output_with_malformed_id();
+    DBusAsyncReplyString request_wake_trace();
+    DBusAsyncReplyString request_loop_statistics();
     DBusAsyncReply request_active_outputs_property();
+    DBusAsyncReply request_outputs_property();
     DBusAsyncReply request_all_properties();
     DBusAsyncReply request_invalid_method();
 
     DBusMessageHandle listen_for_properties_changed();
+    // Returns a null handle if no signal arrives within the timeout
+    DBusMessageHandle listen_for_properties_changed(std::chrono::milliseconds timeout);
+    DBusMessageHandle listen_for_power_state_changed();
 
     char const* const unity_display_interface = "com.canonical.Unity.Display";
 };
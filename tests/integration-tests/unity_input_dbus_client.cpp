@@ -110,4 +110,39 @@ ut::DBusAsyncReplyVoid ut::UnityInputDBusClient::request_set_touchpad_disable_wh
     return request("setTouchpadDisableWhileTyping", enabled);
 }
 
+ut::DBusAsyncReplyVoid ut::UnityInputDBusClient::request_apply_settings(
+    std::vector<Setting> const& settings)
+{
+    return DBusAsyncReplyVoid{invoke_with_pending(
+        unity_input_interface, "ApplySettings",
+        [&settings] (DBusMessageIter* iter)
+        {
+            DBusMessageIter iter_dict;
+            dbus_message_iter_open_container(iter, DBUS_TYPE_ARRAY, "{sv}", &iter_dict);
+
+            for (auto const& setting : settings)
+            {
+                char const signature[] = {static_cast<char>(setting.type), '\0'};
+
+                DBusMessageIter iter_entry;
+                dbus_message_iter_open_container(&iter_dict, DBUS_TYPE_DICT_ENTRY, nullptr, &iter_entry);
+                dbus_message_iter_append_basic(&iter_entry, DBUS_TYPE_STRING, &setting.key);
+
+                DBusMessageIter iter_variant;
+                dbus_message_iter_open_container(&iter_entry, DBUS_TYPE_VARIANT, signature, &iter_variant);
+                dbus_message_iter_append_basic(&iter_variant, setting.type, setting.value);
+                dbus_message_iter_close_container(&iter_entry, &iter_variant);
+
+                dbus_message_iter_close_container(&iter_dict, &iter_entry);
+            }
+
+            dbus_message_iter_close_container(iter, &iter_dict);
+        })};
+}
 
+ut::DBusAsyncReply ut::UnityInputDBusClient::request_get_settings()
+{
+    return invoke_with_reply<ut::DBusAsyncReply>(
+        unity_input_interface, "GetSettings",
+        DBUS_TYPE_INVALID);
+}
@@ -21,6 +21,8 @@
 
 #include "dbus_client.h"
 
+#include <vector>
+
 namespace usc
 {
 namespace test
@@ -43,6 +45,15 @@ public:
     DBusAsyncReplyVoid request_set_touchpad_tap_to_click(bool enabled);
     DBusAsyncReplyVoid request_set_touchpad_disable_with_mouse(bool enabled);
     DBusAsyncReplyVoid request_set_touchpad_disable_while_typing(bool enabled);
+
+    struct Setting
+    {
+        char const* key;
+        int type;
+        void const* value;
+    };
+    DBusAsyncReplyVoid request_apply_settings(std::vector<Setting> const& settings);
+    DBusAsyncReply request_get_settings();
     char const* const unity_input_interface = "com.canonical.Unity.Input";
 };
 
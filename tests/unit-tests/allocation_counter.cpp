@@ -0,0 +1,65 @@
+/*
+ * Copyright © 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "allocation_counter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+std::atomic<int> allocations{0};
+}
+
+void* operator new(std::size_t size)
+{
+    ++allocations;
+
+    if (auto const ptr = std::malloc(size ? size : 1))
+        return ptr;
+
+    throw std::bad_alloc{};
+}
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+AllocationCounter::AllocationCounter()
+    : start_count{allocations.load()},
+      stop_count{-1}
+{
+}
+
+AllocationCounter::~AllocationCounter() = default;
+
+void AllocationCounter::stop()
+{
+    if (stop_count < 0)
+        stop_count = allocations.load();
+}
+
+int AllocationCounter::count() const
+{
+    return (stop_count < 0 ? allocations.load() : stop_count) - start_count;
+}
@@ -0,0 +1,38 @@
+/*
+ * Copyright © 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef USC_TESTS_ALLOCATION_COUNTER_H_
+#define USC_TESTS_ALLOCATION_COUNTER_H_
+
+// Counts calls to the global operator new, from any thread, while alive
+class AllocationCounter
+{
+public:
+    AllocationCounter();
+    ~AllocationCounter();
+
+    void stop();
+    int count() const;
+
+private:
+    AllocationCounter(AllocationCounter const&) = delete;
+    AllocationCounter& operator=(AllocationCounter const&) = delete;
+
+    int const start_count;
+    int stop_count;
+};
+
+#endif
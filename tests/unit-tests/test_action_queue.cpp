@@ -0,0 +1,226 @@
+/*
+ * Copyright © 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "src/action_queue.h"
+
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include "allocation_counter.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace testing;
+
+namespace
+{
+
+struct AnActionQueue : testing::Test
+{
+    usc::ActionQueue queue;
+    std::vector<int> dispatched;
+};
+
+}
+
+TEST_F(AnActionQueue, dispatches_actions_in_push_order)
+{
+    for (int i = 0; i < 5; ++i)
+        queue.push([this,i] { dispatched.push_back(i); });
+
+    queue.dispatch();
+
+    EXPECT_THAT(dispatched, ElementsAre(0, 1, 2, 3, 4));
+}
+
+TEST_F(AnActionQueue, reports_only_transition_from_empty)
+{
+    EXPECT_TRUE(queue.push([]{}));
+    EXPECT_FALSE(queue.push([]{}));
+    EXPECT_FALSE(queue.push([]{}));
+
+    queue.dispatch();
+
+    EXPECT_TRUE(queue.push([]{}));
+}
+
+TEST_F(AnActionQueue, defers_actions_pushed_during_dispatch)
+{
+    queue.push(
+        [this]
+        {
+            dispatched.push_back(0);
+            queue.push([this] { dispatched.push_back(1); });
+        });
+
+    queue.dispatch();
+    EXPECT_THAT(dispatched, ElementsAre(0));
+
+    queue.dispatch();
+    EXPECT_THAT(dispatched, ElementsAre(0, 1));
+}
+
+TEST_F(AnActionQueue, dispatches_all_actions_from_concurrent_producers)
+{
+    int const num_producers = 4;
+    int const actions_per_producer = 10000;
+
+    std::vector<std::vector<int>> per_producer(num_producers);
+    std::vector<std::thread> producers;
+
+    for (int p = 0; p < num_producers; ++p)
+    {
+        producers.emplace_back(
+            [&,p]
+            {
+                for (int i = 0; i < actions_per_producer; ++i)
+                    queue.push([&,p,i] { per_producer[p].push_back(i); });
+            });
+    }
+
+    for (auto& producer : producers)
+        producer.join();
+
+    queue.dispatch();
+
+    for (auto const& dispatched_for_producer : per_producer)
+    {
+        ASSERT_THAT(dispatched_for_producer.size(), Eq(actions_per_producer));
+        for (int i = 0; i < actions_per_producer; ++i)
+            EXPECT_THAT(dispatched_for_producer[i], Eq(i));
+    }
+}
+
+TEST_F(AnActionQueue, keeps_order_when_overflowing)
+{
+    usc::ActionQueue small_queue{4};
+
+    for (int i = 0; i < 10; ++i)
+        small_queue.push([this,i] { dispatched.push_back(i); });
+
+    small_queue.dispatch();
+    small_queue.push([this] { dispatched.push_back(10); });
+    small_queue.dispatch();
+
+    EXPECT_THAT(dispatched, ElementsAre(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10));
+}
+
+TEST_F(AnActionQueue, keeps_order_when_overflowing_during_dispatch)
+{
+    usc::ActionQueue small_queue{4};
+
+    // The slots freed by the dispatch are refilled past the point it
+    // started from, and the rest overflows
+    small_queue.push(
+        [&]
+        {
+            for (int i = 0; i < 6; ++i)
+                small_queue.push([this,i] { dispatched.push_back(i); });
+        });
+
+    while (small_queue.dispatch())
+        ;
+
+    EXPECT_THAT(dispatched, ElementsAre(0, 1, 2, 3, 4, 5));
+}
+
+TEST_F(AnActionQueue, keeps_order_of_each_producer_when_overflowing_during_dispatch)
+{
+    usc::ActionQueue small_queue{4};
+    int const num_producers = 4;
+    int const actions_per_producer = 2000;
+
+    std::vector<std::vector<int>> per_producer(num_producers);
+    std::atomic<int> producers_done{0};
+    std::vector<std::thread> producers;
+
+    for (int p = 0; p < num_producers; ++p)
+    {
+        producers.emplace_back(
+            [&,p]
+            {
+                for (int i = 0; i < actions_per_producer; ++i)
+                {
+                    small_queue.push(
+                        [&,p,i]
+                        {
+                            per_producer[p].push_back(i);
+                            // Give producers time to refill the ring
+                            std::this_thread::yield();
+                        });
+                }
+                ++producers_done;
+            });
+    }
+
+    // Dispatch while the producers keep spilling over the small ring
+    while (producers_done < num_producers)
+        small_queue.dispatch();
+
+    for (auto& producer : producers)
+        producer.join();
+
+    while (small_queue.dispatch())
+        ;
+
+    for (auto const& dispatched_for_producer : per_producer)
+    {
+        ASSERT_THAT(dispatched_for_producer.size(), Eq(actions_per_producer));
+        for (int i = 0; i < actions_per_producer; ++i)
+            ASSERT_THAT(dispatched_for_producer[i], Eq(i));
+    }
+}
+
+TEST_F(AnActionQueue, reports_actions_left_for_next_dispatch)
+{
+    queue.push([this] { queue.push([]{}); });
+
+    EXPECT_TRUE(queue.dispatch());
+    EXPECT_FALSE(queue.dispatch());
+}
+
+TEST_F(AnActionQueue, does_not_allocate_when_pushing_and_dispatching)
+{
+    struct Payload { void* self; int internal; int external; } const payload{this, 1, 2};
+    int const cycles = 100000;
+    int sum{0};
+
+    dispatched.reserve(1);
+
+    AllocationCounter allocations;
+
+    auto const start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < cycles; ++i)
+    {
+        queue.push([payload,&sum] { sum += payload.internal + payload.external; });
+        queue.dispatch();
+    }
+
+    auto const end = std::chrono::steady_clock::now();
+
+    allocations.stop();
+
+    auto const ns_per_cycle =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() / cycles;
+    RecordProperty("ns_per_push_dispatch_cycle", static_cast<int>(ns_per_cycle));
+
+    EXPECT_THAT(sum, Eq(3 * cycles));
+    EXPECT_THAT(allocations.count(), Eq(0));
+}
@@ -0,0 +1,111 @@
+/*
+ * Copyright © 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "src/dbus_method_table.h"
+#include "src/dbus_message_handle.h"
+
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <string>
+#include <vector>
+
+using namespace testing;
+
+namespace
+{
+
+usc::DBusMethodDescription const methods[] = {
+    {"com.test.A", "First", "i"},
+    {"com.test.A", "Second", "s"},
+    {"com.test.B", "First", ""},
+    {"com.test.B", "Unbound", ""},
+};
+
+struct ADBusMethodTable : testing::Test
+{
+    usc::DBusMessageHandle method_call(char const* interface, char const* member)
+    {
+        return usc::DBusMessageHandle{
+            dbus_message_new_method_call("com.test", "/com/test", interface, member)};
+    }
+
+    std::vector<std::string> called;
+    usc::DBusMethodTable const table{
+        methods,
+        {{"com.test.A", "First", [this] (DBusMessage*) { called.push_back("A.First"); }},
+         {"com.test.A", "Second", [this] (DBusMessage*) { called.push_back("A.Second"); }},
+         {"com.test.B", "First", [this] (DBusMessage*) { called.push_back("B.First"); }, true}}};
+};
+
+}
+
+TEST_F(ADBusMethodTable, finds_handlers_by_interface_and_member)
+{
+    for (auto const& call : {std::make_pair("com.test.B", "First"),
+                             std::make_pair("com.test.A", "Second"),
+                             std::make_pair("com.test.A", "First")})
+    {
+        auto const message = method_call(call.first, call.second);
+        auto const method = table.find(message);
+        ASSERT_THAT(method, NotNull());
+        method->handler(message);
+    }
+
+    EXPECT_THAT(called, ElementsAre("B.First", "A.Second", "A.First"));
+}
+
+TEST_F(ADBusMethodTable, does_not_find_unknown_or_unbound_methods)
+{
+    EXPECT_THAT(table.find(method_call("com.test.A", "Third")), IsNull());
+    EXPECT_THAT(table.find(method_call("com.test.C", "First")), IsNull());
+    EXPECT_THAT(table.find(method_call("com.test.B", "Unbound")), IsNull());
+}
+
+TEST_F(ADBusMethodTable, ignores_messages_that_are_not_method_calls)
+{
+    usc::DBusMessageHandle const signal{
+        dbus_message_new_signal("/com/test", "com.test.A", "First")};
+
+    EXPECT_THAT(table.find(signal), IsNull());
+}
+
+TEST_F(ADBusMethodTable, checks_arguments_against_described_signature)
+{
+    int32_t const i{1};
+    usc::DBusMessageHandle const good{
+        dbus_message_new_method_call("com.test", "/com/test", "com.test.A", "First"),
+        DBUS_TYPE_INT32, &i,
+        DBUS_TYPE_INVALID};
+    auto const bad = method_call("com.test.A", "First");
+
+    EXPECT_TRUE(table.find(good)->accepts_arguments_of(good));
+    EXPECT_FALSE(table.find(bad)->accepts_arguments_of(bad));
+}
+
+TEST_F(ADBusMethodTable, keeps_whether_each_method_is_rate_limited)
+{
+    EXPECT_FALSE(table.find(method_call("com.test.A", "First"))->rate_limited);
+    EXPECT_FALSE(table.find(method_call("com.test.A", "Second"))->rate_limited);
+    EXPECT_TRUE(table.find(method_call("com.test.B", "First"))->rate_limited);
+}
+
+TEST_F(ADBusMethodTable, rejects_bindings_for_undescribed_methods)
+{
+    EXPECT_THROW({
+        usc::DBusMethodTable table(methods, {{"com.test.A", "Missing", [] (DBusMessage*) {}}});
+    }, std::logic_error);
+}
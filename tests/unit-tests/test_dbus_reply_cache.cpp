@@ -0,0 +1,111 @@
+/*
+ * Copyright © 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "src/dbus_reply_cache.h"
+#include "src/dbus_message_handle.h"
+
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <string>
+
+using namespace testing;
+
+namespace
+{
+
+struct ADBusReplyCache : testing::Test
+{
+    usc::DBusMessageHandle method_call(dbus_uint32_t serial, char const* sender)
+    {
+        usc::DBusMessageHandle call{
+            dbus_message_new_method_call(nullptr, "/com/test", "com.test", "Method")};
+        dbus_message_set_serial(call, serial);
+        dbus_message_set_sender(call, sender);
+        return call;
+    }
+
+    usc::DBusReplyCache::Marshaller string_marshaller(char const* value)
+    {
+        return [this, value] (DBusMessage* reply)
+            {
+                ++marshalled;
+                dbus_message_append_args(reply, DBUS_TYPE_STRING, &value, DBUS_TYPE_INVALID);
+            };
+    }
+
+    std::string string_of(DBusMessage* reply)
+    {
+        char const* value{""};
+        dbus_message_get_args(reply, nullptr, DBUS_TYPE_STRING, &value, DBUS_TYPE_INVALID);
+        return value;
+    }
+
+    usc::DBusReplyCache::Key const key{0};
+    usc::DBusReplyCache::Key const a{1};
+    usc::DBusReplyCache::Key const b{5};
+
+    usc::DBusReplyCache cache;
+    int marshalled{0};
+};
+
+}
+
+TEST_F(ADBusReplyCache, addresses_each_reply_to_its_call)
+{
+    auto const first = cache.reply_to(method_call(7, ":1.7"), key, string_marshaller("value"));
+    auto const second = cache.reply_to(method_call(9, ":1.9"), key, string_marshaller("value"));
+
+    EXPECT_THAT(dbus_message_get_type(first), Eq(DBUS_MESSAGE_TYPE_METHOD_RETURN));
+    EXPECT_THAT(dbus_message_get_reply_serial(first), Eq(7u));
+    EXPECT_THAT(dbus_message_get_destination(first), StrEq(":1.7"));
+    EXPECT_THAT(dbus_message_get_reply_serial(second), Eq(9u));
+    EXPECT_THAT(dbus_message_get_destination(second), StrEq(":1.9"));
+    EXPECT_THAT(string_of(first), StrEq("value"));
+    EXPECT_THAT(string_of(second), StrEq("value"));
+}
+
+TEST_F(ADBusReplyCache, marshals_body_once_per_key)
+{
+    cache.reply_to(method_call(1, ":1.1"), a, string_marshaller("a"));
+    cache.reply_to(method_call(2, ":1.1"), a, string_marshaller("a"));
+    auto const reply = cache.reply_to(method_call(3, ":1.1"), b, string_marshaller("b"));
+
+    EXPECT_THAT(marshalled, Eq(2));
+    EXPECT_THAT(string_of(reply), StrEq("b"));
+}
+
+TEST_F(ADBusReplyCache, marshals_body_again_after_invalidation)
+{
+    cache.reply_to(method_call(1, ":1.1"), key, string_marshaller("old"));
+    cache.invalidate(key);
+    auto const reply = cache.reply_to(method_call(2, ":1.1"), key, string_marshaller("new"));
+
+    EXPECT_THAT(marshalled, Eq(2));
+    EXPECT_THAT(string_of(reply), StrEq("new"));
+}
+
+TEST_F(ADBusReplyCache, keeps_other_keys_cached_after_invalidation)
+{
+    cache.reply_to(method_call(1, ":1.1"), a, string_marshaller("a"));
+    cache.reply_to(method_call(2, ":1.1"), b, string_marshaller("b"));
+    cache.invalidate(b);
+    cache.invalidate(b + 1);
+    auto const reply = cache.reply_to(method_call(3, ":1.1"), a, string_marshaller("a"));
+
+    EXPECT_THAT(marshalled, Eq(2));
+    EXPECT_THAT(string_of(reply), StrEq("a"));
+}
@@ -0,0 +1,81 @@
+/*
+ * Copyright © 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "src/histogram.h"
+
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+using namespace testing;
+
+namespace
+{
+
+struct AHistogram : testing::Test
+{
+    usc::Histogram histogram;
+};
+
+}
+
+TEST_F(AHistogram, starts_out_empty)
+{
+    auto const snapshot = histogram.snapshot();
+
+    EXPECT_THAT(snapshot.samples, Eq(0u));
+    EXPECT_THAT(snapshot.sum, Eq(0u));
+    EXPECT_THAT(snapshot.max, Eq(0u));
+    EXPECT_THAT(snapshot.percentile(0.99), Eq(0u));
+}
+
+TEST_F(AHistogram, counts_values_in_power_of_two_buckets)
+{
+    for (uint64_t value : {0, 1, 2, 3, 4, 7, 8})
+        histogram.record(value);
+
+    auto const snapshot = histogram.snapshot();
+
+    EXPECT_THAT(snapshot.counts[0], Eq(1u));
+    EXPECT_THAT(snapshot.counts[1], Eq(1u));
+    EXPECT_THAT(snapshot.counts[2], Eq(2u));
+    EXPECT_THAT(snapshot.counts[3], Eq(2u));
+    EXPECT_THAT(snapshot.counts[4], Eq(1u));
+    EXPECT_THAT(snapshot.samples, Eq(7u));
+    EXPECT_THAT(snapshot.sum, Eq(25u));
+    EXPECT_THAT(snapshot.max, Eq(8u));
+}
+
+TEST_F(AHistogram, puts_huge_values_in_last_bucket)
+{
+    histogram.record(UINT64_MAX);
+
+    auto const snapshot = histogram.snapshot();
+
+    EXPECT_THAT(snapshot.counts[usc::Histogram::num_buckets - 1], Eq(1u));
+}
+
+TEST_F(AHistogram, estimates_percentiles_from_bucket_bounds)
+{
+    for (int i = 0; i < 99; ++i)
+        histogram.record(10);
+    histogram.record(1000);
+
+    auto const snapshot = histogram.snapshot();
+
+    EXPECT_THAT(snapshot.percentile(0.5), Eq(15u));
+    EXPECT_THAT(snapshot.percentile(0.99), Eq(15u));
+    EXPECT_THAT(snapshot.percentile(1.0), Eq(1000u));
+}
@@ -129,3 +129,22 @@ TEST_F(MirInputConfiguration, ignores_keyboard_when_added)
     obs->device_added(mock_keyboard);
 }
 
+
+TEST_F(MirInputConfiguration, applies_settings_to_each_device_once)
+{
+    usc::MirInputConfiguration config(mock_hub);
+    obs->device_added(mock_mouse);
+    obs->device_added(mock_touchpad);
+
+    auto settings = config.settings();
+    settings.mouse_cursor_speed = 0.75;
+    settings.tap_to_click = !settings.tap_to_click;
+    settings.two_finger_scroll = !settings.two_finger_scroll;
+
+    EXPECT_CALL(*mock_mouse, apply_pointer_configuration(_)).Times(1);
+    EXPECT_CALL(*mock_touchpad, apply_pointer_configuration(_)).Times(1);
+    EXPECT_CALL(*mock_touchpad, apply_touchpad_configuration(_)).Times(1);
+    config.apply_settings(settings);
+
+    EXPECT_THAT(config.settings(), Eq(settings));
+}
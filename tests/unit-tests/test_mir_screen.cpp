@@ -17,6 +17,7 @@
  */
 
 #include "src/mir_screen.h"
+#include "src/tracer.h"
 
 #include "usc/test/mock_display.h"
 #include "usc/test/stub_display_configuration.h"
@@ -28,6 +29,13 @@
 #include <gtest/gtest.h>
 #include <gmock/gmock.h>
 
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <map>
+#include <thread>
+#include <vector>
+
 using namespace testing;
 
 namespace mg = mir::graphics;
@@ -50,6 +58,17 @@ struct MockDisplayWithExternalOutputs : ut::MockDisplay
     }
 };
 
+struct MockDisplayCountingConfigurationQueries : ut::MockDisplay
+{
+    std::unique_ptr<mir::graphics::DisplayConfiguration> configuration() const override
+    {
+        ++configuration_queries;
+        return ut::MockDisplay::configuration();
+    }
+
+    mutable int configuration_queries{0};
+};
+
 struct AMirScreen : testing::Test
 {
     void turn_all_displays_off()
@@ -79,7 +98,7 @@ struct AMirScreen : testing::Test
     void use_mir_screen_with_external_outputs()
     {
         display = std::make_shared<testing::NiceMock<MockDisplayWithExternalOutputs>>();
-        mir_screen = std::make_shared<usc::MirScreen>(compositor, display);
+        mir_screen = std::make_shared<usc::MirScreen>(compositor, display, tracer);
     }
 
     std::shared_ptr<MockCompositor> compositor{
@@ -94,6 +113,8 @@ struct AMirScreen : testing::Test
         config_active_outputs.external,
         config_inactive_outputs};
 
+    std::shared_ptr<usc::Tracer> const tracer{std::make_shared<usc::Tracer>()};
+
     usc::ActiveOutputs active_outputs{-1,-1};
     usc::ActiveOutputsHandler active_outputs_handler =
         [this] (usc::ActiveOutputs const& active_outputs_arg)
@@ -102,7 +123,7 @@ struct AMirScreen : testing::Test
         };
 
     std::shared_ptr<usc::MirScreen> mir_screen{
-        std::make_shared<usc::MirScreen>(compositor, display)};
+        std::make_shared<usc::MirScreen>(compositor, display, tracer)};
 };
 
 }
@@ -173,3 +194,285 @@ TEST_F(AMirScreen, configuration_applied_calls_handler)
 
     EXPECT_THAT(active_outputs, Eq(config_active_outputs));
 }
+
+TEST_F(AMirScreen, turns_off_only_the_requested_output)
+{
+    use_mir_screen_with_external_outputs();
+
+    std::map<int, MirPowerMode> power_modes;
+    EXPECT_CALL(*display, configure(_))
+        .WillOnce(Invoke(
+            [&] (mg::DisplayConfiguration const& conf)
+            {
+                conf.for_each_output(
+                    [&] (mg::DisplayConfigurationOutput const& output)
+                    {
+                        if (output.used)
+                            power_modes[output.id.as_value()] = output.power_mode;
+                    });
+            }));
+    EXPECT_CALL(*compositor, start());
+
+    mir_screen->turn_off_output(2);
+
+    EXPECT_THAT(power_modes, ContainerEq(std::map<int, MirPowerMode>{
+        {1, mir_power_mode_on},
+        {2, mir_power_mode_off},
+        {3, mir_power_mode_on},
+        {4, mir_power_mode_on},
+        {5, mir_power_mode_on}}));
+}
+
+TEST_F(AMirScreen, ignores_power_requests_for_unknown_outputs)
+{
+    std::vector<MirPowerMode> power_modes;
+    ON_CALL(*display, configure(_))
+        .WillByDefault(Invoke(
+            [&] (mg::DisplayConfiguration const& conf)
+            {
+                conf.for_each_output(
+                    [&] (mg::DisplayConfigurationOutput const& output)
+                    {
+                        power_modes.push_back(output.power_mode);
+                    });
+            }));
+
+    mir_screen->turn_off_output(42);
+
+    EXPECT_THAT(power_modes, Each(Eq(mir_power_mode_on)));
+}
+
+TEST_F(AMirScreen, registered_outputs_handler_is_called_immediately)
+{
+    usc::Outputs outputs;
+    mir_screen->register_outputs_handler(
+        [&] (usc::Outputs const& outputs_arg) { outputs = outputs_arg; });
+
+    EXPECT_THAT(outputs, ElementsAre(usc::Output{1, usc::OutputType::internal, true, true, true}));
+}
+
+TEST_F(AMirScreen, configuration_applied_calls_outputs_handler_with_output_table)
+{
+    usc::Outputs outputs;
+    mir_screen->register_outputs_handler(
+        [&] (usc::Outputs const& outputs_arg) { outputs = outputs_arg; });
+
+    mir_screen->configuration_applied(ut::fake_shared(stub_display_configuration));
+
+    EXPECT_THAT(outputs, ElementsAre(
+        usc::Output{1, usc::OutputType::internal, true, true, true},
+        usc::Output{2, usc::OutputType::external, true, true, true},
+        usc::Output{3, usc::OutputType::external, true, true, true},
+        usc::Output{4, usc::OutputType::external, true, true, true},
+        usc::Output{5, usc::OutputType::internal, false, false, false},
+        usc::Output{6, usc::OutputType::internal, false, false, false}));
+}
+
+TEST_F(AMirScreen, does_not_call_outputs_handler_if_outputs_are_unchanged)
+{
+    mir_screen->configuration_applied(ut::fake_shared(stub_display_configuration));
+
+    int calls{0};
+    mir_screen->register_outputs_handler([&] (usc::Outputs const&) { ++calls; });
+
+    mir_screen->configuration_applied(ut::fake_shared(stub_display_configuration));
+
+    EXPECT_THAT(calls, Eq(1));
+}
+
+TEST_F(AMirScreen, keeps_compositing_when_turning_off_output_preserves_display_buffers)
+{
+    use_mir_screen_with_external_outputs();
+
+    ON_CALL(*display, apply_if_configuration_preserves_display_buffers(_))
+        .WillByDefault(Return(true));
+
+    EXPECT_CALL(*display, apply_if_configuration_preserves_display_buffers(_));
+    EXPECT_CALL(*compositor, stop()).Times(0);
+    EXPECT_CALL(*display, configure(_)).Times(0);
+
+    mir_screen->turn_off_output(2);
+}
+
+TEST_F(AMirScreen, stops_compositing_without_reconfiguring_when_turning_off_last_active_output)
+{
+    ON_CALL(*display, apply_if_configuration_preserves_display_buffers(_))
+        .WillByDefault(Return(true));
+
+    EXPECT_CALL(*compositor, stop());
+    EXPECT_CALL(*display, configure(_)).Times(0);
+
+    turn_all_displays_off();
+}
+
+TEST_F(AMirScreen, starts_compositing_without_reconfiguring_when_turning_on_preserves_display_buffers)
+{
+    turn_all_displays_off();
+
+    ON_CALL(*display, apply_if_configuration_preserves_display_buffers(_))
+        .WillByDefault(Return(true));
+
+    EXPECT_CALL(*compositor, stop()).Times(0);
+    EXPECT_CALL(*display, configure(_)).Times(0);
+    EXPECT_CALL(*compositor, start());
+
+    turn_all_displays_on();
+}
+
+TEST_F(AMirScreen, reconfigures_with_compositing_stopped_when_display_buffers_are_not_preserved)
+{
+    use_mir_screen_with_external_outputs();
+
+    InSequence s;
+    EXPECT_CALL(*display, apply_if_configuration_preserves_display_buffers(_))
+        .WillOnce(Return(false));
+    EXPECT_CALL(*compositor, stop());
+    EXPECT_CALL(*display, configure(_));
+    EXPECT_CALL(*compositor, start());
+
+    mir_screen->turn_off_output(2);
+}
+
+TEST_F(AMirScreen, does_not_reconfigure_when_requested_power_mode_is_already_applied)
+{
+    turn_all_displays_off();
+
+    EXPECT_CALL(*display, apply_if_configuration_preserves_display_buffers(_)).Times(0);
+    EXPECT_CALL(*compositor, stop()).Times(0);
+    EXPECT_CALL(*display, configure(_)).Times(0);
+
+    turn_all_displays_off();
+}
+
+TEST_F(AMirScreen, reconfigures_when_configuration_applied_reports_a_different_power_mode)
+{
+    turn_all_displays_off();
+
+    // Someone else has turned the displays back on
+    mir_screen->configuration_applied(ut::fake_shared(stub_display_configuration));
+
+    EXPECT_CALL(*compositor, stop());
+    EXPECT_CALL(*display, configure(_));
+
+    turn_all_displays_off();
+}
+
+TEST_F(AMirScreen, does_not_query_display_configuration_when_changing_power)
+{
+    auto const counting_display =
+        std::make_shared<NiceMock<MockDisplayCountingConfigurationQueries>>();
+    display = counting_display;
+    mir_screen = std::make_shared<usc::MirScreen>(compositor, display, tracer);
+    auto const queries = counting_display->configuration_queries;
+
+    turn_all_displays_off();
+    turn_all_displays_on();
+
+    EXPECT_THAT(counting_display->configuration_queries, Eq(queries));
+}
+
+TEST_F(AMirScreen, changes_power_on_latest_applied_configuration)
+{
+    mir_screen->configuration_applied(ut::fake_shared(stub_display_configuration));
+
+    std::map<int, MirPowerMode> power_modes;
+    EXPECT_CALL(*display, configure(_))
+        .WillOnce(Invoke(
+            [&] (mg::DisplayConfiguration const& conf)
+            {
+                conf.for_each_output(
+                    [&] (mg::DisplayConfigurationOutput const& output)
+                    {
+                        if (output.used)
+                            power_modes[output.id.as_value()] = output.power_mode;
+                    });
+            }));
+
+    mir_screen->turn_off_output(3);
+
+    EXPECT_THAT(power_modes, ContainerEq(std::map<int, MirPowerMode>{
+        {1, mir_power_mode_on},
+        {2, mir_power_mode_on},
+        {3, mir_power_mode_off},
+        {4, mir_power_mode_on}}));
+}
+
+TEST_F(AMirScreen, traces_reconfiguration_stages_under_the_current_transition)
+{
+    turn_all_displays_off();
+
+    {
+        usc::Tracer::TransitionScope const scope{7};
+        turn_all_displays_on();
+    }
+
+    auto const trace = tracer->chrome_trace_json();
+    auto const begin = trace.find(R"("name":"display_configure_begin")");
+    auto const end = trace.find(R"("name":"display_configure_end")", begin);
+    auto const started = trace.find(R"("name":"compositor_started")", end);
+
+    EXPECT_THAT(begin, Ne(std::string::npos));
+    EXPECT_THAT(end, Ne(std::string::npos));
+    EXPECT_THAT(started, Ne(std::string::npos));
+    EXPECT_THAT(trace.substr(started), HasSubstr(R"("args":{"transition":7})"));
+}
+
+TEST_F(AMirScreen, allows_power_changes_from_active_outputs_handler)
+{
+    mir_screen->configuration_applied(ut::fake_shared(stub_display_configuration));
+
+    EXPECT_CALL(*display, configure(_));
+
+    mir_screen->register_active_outputs_handler(
+        [this] (usc::ActiveOutputs const& active_outputs)
+        {
+            if (active_outputs.external > 0)
+                mir_screen->turn_off(usc::OutputFilter::external);
+        });
+}
+
+TEST_F(AMirScreen, does_not_call_replaced_handler_after_registration_returns)
+{
+    std::promise<void> release_handler;
+    auto handler_released = release_handler.get_future().share();
+    std::atomic<bool> in_old_handler{false};
+    std::atomic<int> old_handler_calls{0};
+
+    mir_screen->register_active_outputs_handler(
+        [&] (usc::ActiveOutputs const&)
+        {
+            if (++old_handler_calls == 2)
+            {
+                in_old_handler = true;
+                handler_released.wait();
+                in_old_handler = false;
+            }
+        });
+
+    auto applying = std::async(std::launch::async,
+        [this] { mir_screen->configuration_applied(ut::fake_shared(stub_display_configuration)); });
+
+    while (!in_old_handler)
+        std::this_thread::yield();
+
+    std::atomic<bool> registered{false};
+    auto registering = std::async(std::launch::async,
+        [&]
+        {
+            mir_screen->register_active_outputs_handler(active_outputs_handler);
+            registered = true;
+        });
+
+    // Registration waits for the old handler to finish
+    std::this_thread::sleep_for(std::chrono::milliseconds{50});
+    EXPECT_FALSE(registered);
+
+    release_handler.set_value();
+    applying.get();
+    registering.get();
+
+    mir_screen->configuration_applied(ut::fake_shared(stub_display_configuration));
+
+    EXPECT_THAT(old_handler_calls.load(), Eq(2));
+    EXPECT_THAT(active_outputs, Eq(config_active_outputs));
+}
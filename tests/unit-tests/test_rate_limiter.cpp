@@ -0,0 +1,160 @@
+/*
+ * Copyright © 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "src/rate_limiter.h"
+#include "src/dbus_message_handle.h"
+
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include "allocation_counter.h"
+
+#include <stdexcept>
+#include <string>
+
+using namespace testing;
+using namespace std::chrono_literals;
+
+namespace
+{
+
+struct ARateLimiter : testing::Test
+{
+    unsigned int const burst{3};
+    usc::RateLimiter limiter{burst, 2.0};
+    usc::RateLimiter::Clock::time_point const start{};
+
+    // Only the addresses of peer connections matter to the limiter
+    char peer_connections[2];
+    DBusConnection* const peer{reinterpret_cast<DBusConnection*>(&peer_connections[0])};
+    DBusConnection* const other_peer{reinterpret_cast<DBusConnection*>(&peer_connections[1])};
+
+    int admitted_calls(std::string const& sender, int calls,
+                       usc::RateLimiter::Clock::time_point now)
+    {
+        int admitted{0};
+        for (int i = 0; i < calls; ++i)
+        {
+            if (limiter.admit(sender, now))
+                ++admitted;
+        }
+        return admitted;
+    }
+};
+
+}
+
+TEST_F(ARateLimiter, admits_a_burst_of_calls)
+{
+    EXPECT_THAT(admitted_calls(":1.1", burst, start), Eq(burst));
+}
+
+TEST_F(ARateLimiter, rejects_calls_beyond_the_burst)
+{
+    admitted_calls(":1.1", burst, start);
+
+    EXPECT_FALSE(limiter.admit(":1.1", start));
+    EXPECT_FALSE(limiter.admit(":1.1", start + 100ms));
+}
+
+TEST_F(ARateLimiter, admits_calls_at_the_sustained_rate)
+{
+    admitted_calls(":1.1", burst, start);
+
+    EXPECT_TRUE(limiter.admit(":1.1", start + 500ms));
+    EXPECT_FALSE(limiter.admit(":1.1", start + 500ms));
+    EXPECT_THAT(admitted_calls(":1.1", burst + 1, start + 1500ms), Eq(2));
+}
+
+TEST_F(ARateLimiter, never_accumulates_more_than_the_burst)
+{
+    admitted_calls(":1.1", burst, start);
+
+    EXPECT_THAT(admitted_calls(":1.1", burst + 1, start + 1h), Eq(burst));
+}
+
+TEST_F(ARateLimiter, limits_each_sender_separately)
+{
+    admitted_calls(":1.1", burst, start);
+
+    EXPECT_FALSE(limiter.admit(":1.1", start));
+    EXPECT_THAT(admitted_calls(":1.2", burst, start), Eq(burst));
+}
+
+TEST_F(ARateLimiter, keeps_limiting_busy_senders_while_tracking_many)
+{
+    admitted_calls(":1.1", burst, start);
+
+    for (int i = 0; i < 200; ++i)
+        limiter.admit(":2." + std::to_string(i), start);
+
+    EXPECT_FALSE(limiter.admit(":1.1", start));
+}
+
+TEST_F(ARateLimiter, tracks_a_limited_number_of_busy_senders)
+{
+    for (int i = 0; i < 200; ++i)
+        admitted_calls(":2." + std::to_string(i), burst, start + i * 1ms);
+
+    EXPECT_THAT(limiter.tracked_senders(), Eq(usc::RateLimiter::max_tracked_senders));
+    // The newest sender is still limited
+    EXPECT_FALSE(limiter.admit(":2.199", start + 199ms));
+}
+
+TEST_F(ARateLimiter, limits_each_peer_separately)
+{
+    for (unsigned int i = 0; i < burst; ++i)
+        limiter.admit(peer, start);
+
+    EXPECT_FALSE(limiter.admit(peer, start));
+    EXPECT_TRUE(limiter.admit(other_peer, start));
+}
+
+TEST_F(ARateLimiter, starts_afresh_for_a_forgotten_peer)
+{
+    for (unsigned int i = 0; i < burst; ++i)
+        limiter.admit(peer, start);
+
+    limiter.forget_peer(peer);
+
+    EXPECT_TRUE(limiter.admit(peer, start));
+}
+
+TEST_F(ARateLimiter, does_not_allocate_for_calls_from_known_senders)
+{
+    usc::DBusMessageHandle const call{
+        dbus_message_new_method_call(nullptr, "/com/test", "com.test", "Method")};
+    dbus_message_set_sender(call, ":1.1234567890123456789");
+    auto const connection = reinterpret_cast<DBusConnection*>(&peer_connections[0]);
+    usc::DBusMessageHandle const peer_call{
+        dbus_message_new_method_call(nullptr, "/com/test", "com.test", "Method")};
+
+    limiter.admit(connection, call);
+    limiter.admit(connection, peer_call);
+
+    AllocationCounter allocations;
+    limiter.admit(connection, call);
+    limiter.admit(connection, peer_call);
+    allocations.stop();
+
+    EXPECT_THAT(allocations.count(), Eq(0));
+}
+
+TEST(ARateLimiterConstruction, rejects_zero_burst_or_rate)
+{
+    EXPECT_THROW({ usc::RateLimiter(0, 1.0); }, std::logic_error);
+    EXPECT_THROW({ usc::RateLimiter(1, 0.0); }, std::logic_error);
+}
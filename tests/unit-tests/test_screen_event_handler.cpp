@@ -19,6 +19,7 @@
 #include "src/screen_event_handler.h"
 #include "src/power_button_event_sink.h"
 #include "src/user_activity_event_sink.h"
+#include "src/tracer.h"
 
 #include "advanceable_timer.h"
 #include "fake_shared.h"
@@ -149,12 +150,14 @@ struct AScreenEventHandler : testing::Test
         {}, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f);
 
     AdvanceableTimer timer;
+    usc::Tracer tracer;
     NiceMock<MockPowerButtonEventSink> mock_power_button_event_sink;
     NiceMock<MockUserActivityEventSink> mock_user_activity_event_sink;
     usc::ScreenEventHandler screen_event_handler{
         usc::test::fake_shared(mock_power_button_event_sink),
         usc::test::fake_shared(mock_user_activity_event_sink),
-        usc::test::fake_shared(timer)};
+        usc::test::fake_shared(timer),
+        usc::test::fake_shared(tracer)};
 };
 
 }
@@ -173,6 +176,20 @@ TEST_F(AScreenEventHandler, notifies_of_power_key_release)
     release_power_key();
 }
 
+TEST_F(AScreenEventHandler, traces_power_key_press_and_release)
+{
+    press_power_key();
+    release_power_key();
+
+    auto const trace = tracer.chrome_trace_json();
+    auto const down = trace.find(R"("name":"power_key_down")");
+
+    EXPECT_THAT(down, Ne(std::string::npos));
+    EXPECT_THAT(trace.find(R"("name":"power_key_up")", down), Ne(std::string::npos));
+    // The press is what the next power request gets linked to
+    EXPECT_THAT(tracer.pending_cause(), Ne(0u));
+}
+
 TEST_F(AScreenEventHandler, notifies_of_activity_extending_power_state_for_touch_event)
 {
     EXPECT_CALL(mock_user_activity_event_sink,
@@ -0,0 +1,81 @@
+/*
+ * Copyright © 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "src/task.h"
+
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <functional>
+#include <memory>
+
+using namespace testing;
+
+TEST(ATask, runs_its_target)
+{
+    int calls{0};
+    usc::Task task{[&calls] { ++calls; }};
+
+    task();
+    task();
+
+    EXPECT_THAT(calls, Eq(2));
+}
+
+TEST(ATask, is_empty_by_default)
+{
+    usc::Task task;
+
+    EXPECT_FALSE(task);
+}
+
+TEST(ATask, moves_its_target)
+{
+    int calls{0};
+    usc::Task task{[&calls] { ++calls; }};
+
+    usc::Task moved_to{std::move(task)};
+    moved_to();
+
+    EXPECT_FALSE(task);
+    EXPECT_TRUE(moved_to);
+    EXPECT_THAT(calls, Eq(1));
+}
+
+TEST(ATask, destroys_its_target_exactly_once)
+{
+    auto const resource = std::make_shared<int>(0);
+
+    {
+        usc::Task task{[resource] {}};
+        usc::Task moved_to;
+        moved_to = std::move(task);
+        EXPECT_THAT(resource.use_count(), Eq(2));
+    }
+
+    EXPECT_THAT(resource.use_count(), Eq(1));
+}
+
+TEST(ATask, holds_std_function_targets)
+{
+    int calls{0};
+    std::function<void()> const function{[&calls] { ++calls; }};
+
+    usc::Task task{function};
+    task();
+
+    EXPECT_THAT(calls, Eq(1));
+}
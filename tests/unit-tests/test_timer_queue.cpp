@@ -0,0 +1,99 @@
+/*
+ * Copyright © 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "src/timer_queue.h"
+
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <poll.h>
+
+#include <vector>
+
+using namespace testing;
+using namespace std::chrono_literals;
+
+namespace
+{
+
+struct ATimerQueue : testing::Test
+{
+    bool wait_for_timer_fd(std::chrono::milliseconds timeout)
+    {
+        pollfd pfd{timer_queue.fd(), POLLIN, 0};
+        return poll(&pfd, 1, timeout.count()) == 1;
+    }
+
+    void wait_and_dispatch()
+    {
+        ASSERT_TRUE(wait_for_timer_fd(default_timeout));
+        timer_queue.dispatch_expired();
+    }
+
+    std::chrono::milliseconds const default_timeout{3000};
+    usc::TimerQueue timer_queue;
+    std::vector<int> fired;
+};
+
+}
+
+TEST_F(ATimerQueue, fires_timers_in_deadline_order)
+{
+    auto const now = usc::TimerQueue::Clock::now();
+
+    timer_queue.schedule(now + 20ms, [this] { fired.push_back(2); });
+    timer_queue.schedule(now + 10ms, [this] { fired.push_back(1); });
+
+    while (fired.size() < 2)
+        wait_and_dispatch();
+
+    EXPECT_THAT(fired, ElementsAre(1, 2));
+}
+
+TEST_F(ATimerQueue, does_not_fire_cancelled_timers)
+{
+    auto const now = usc::TimerQueue::Clock::now();
+
+    auto const id = timer_queue.schedule(now + 5ms, [this] { fired.push_back(1); });
+    timer_queue.schedule(now + 10ms, [this] { fired.push_back(2); });
+
+    EXPECT_TRUE(timer_queue.cancel(id));
+
+    while (fired.empty())
+        wait_and_dispatch();
+
+    EXPECT_THAT(fired, ElementsAre(2));
+    EXPECT_FALSE(timer_queue.cancel(id));
+}
+
+TEST_F(ATimerQueue, rearms_for_earlier_deadline)
+{
+    auto const now = usc::TimerQueue::Clock::now();
+
+    timer_queue.schedule(now + 1h, [this] { fired.push_back(1); });
+    timer_queue.schedule(now + 5ms, [this] { fired.push_back(2); });
+
+    wait_and_dispatch();
+
+    EXPECT_THAT(fired, ElementsAre(2));
+}
+
+TEST_F(ATimerQueue, does_not_signal_fd_before_first_deadline)
+{
+    timer_queue.schedule(usc::TimerQueue::Clock::now() + 1h, [this] { fired.push_back(1); });
+
+    EXPECT_FALSE(wait_for_timer_fd(20ms));
+}
@@ -0,0 +1,153 @@
+/*
+ * Copyright © 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "src/tracer.h"
+
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <regex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace testing;
+
+namespace
+{
+
+// "name/transition", or "name/transition/cause" for points with a cause,
+// for each point in the exported trace
+std::vector<std::string> traced_points(usc::Tracer const& tracer)
+{
+    auto const json = tracer.chrome_trace_json();
+    std::regex const point{
+        "\\{\"name\":\"([^\"]*)\"[^{]*\"args\":\\{\"transition\":([0-9]+)"
+        "(,\"cause\":([0-9]+))?\\}\\}"};
+
+    std::vector<std::string> points;
+    for (std::sregex_iterator iter{json.begin(), json.end(), point}, end; iter != end; ++iter)
+    {
+        points.push_back((*iter)[1].str() + "/" + (*iter)[2].str() +
+                         ((*iter)[4].matched ? "/" + (*iter)[4].str() : ""));
+    }
+
+    return points;
+}
+
+}
+
+TEST(ATracer, exports_no_points_when_nothing_is_traced)
+{
+    usc::Tracer const tracer;
+
+    EXPECT_THAT(tracer.chrome_trace_json(), Eq("{\"traceEvents\":[],\"displayTimeUnit\":\"ms\"}"));
+}
+
+TEST(ATracer, exports_points_in_trace_order)
+{
+    usc::Tracer tracer;
+
+    tracer.trace("power_key_down", 0);
+    tracer.trace("turn_on_requested", 1);
+    tracer.trace("power_transition_completed", 1);
+
+    EXPECT_THAT(traced_points(tracer), ElementsAre(
+        "power_key_down/0", "turn_on_requested/1", "power_transition_completed/1"));
+}
+
+TEST(ATracer, keeps_only_the_latest_points_when_full)
+{
+    usc::Tracer tracer{3};
+
+    tracer.trace("a", 1);
+    tracer.trace("b", 2);
+    tracer.trace("c", 3);
+    tracer.trace("d", 4);
+    tracer.trace("e", 5);
+
+    EXPECT_THAT(traced_points(tracer), ElementsAre("c/3", "d/4", "e/5"));
+}
+
+TEST(ATracer, attributes_points_to_transition_in_scope_on_the_same_thread)
+{
+    usc::Tracer tracer;
+
+    {
+        usc::Tracer::TransitionScope const scope{7};
+        tracer.trace("display_configure_begin");
+
+        std::thread{[&tracer] { tracer.trace("elsewhere"); }}.join();
+
+        {
+            usc::Tracer::TransitionScope const inner_scope{8};
+            tracer.trace("inner");
+        }
+
+        tracer.trace("display_configure_end");
+    }
+
+    tracer.trace("outside");
+
+    EXPECT_THAT(traced_points(tracer), ElementsAre(
+        "display_configure_begin/7", "elsewhere/0", "inner/8",
+        "display_configure_end/7", "outside/0"));
+}
+
+TEST(ATracer, links_the_next_caused_point_to_the_pending_cause)
+{
+    usc::Tracer tracer;
+
+    auto const first = tracer.trace_cause("power_key_down");
+    tracer.trace("power_key_up", 0);
+    tracer.trace_caused("turn_on_requested", 1);
+    tracer.trace_caused("turn_off_requested", 2);
+    auto const second = tracer.trace_cause("power_key_down");
+    tracer.trace("power_button_press_signal", 0, tracer.pending_cause());
+
+    EXPECT_THAT(first, Ne(0u));
+    EXPECT_THAT(second, Ne(first));
+    EXPECT_THAT(traced_points(tracer), ElementsAre(
+        "power_key_down/0/" + std::to_string(first),
+        "power_key_up/0",
+        "turn_on_requested/1/" + std::to_string(first),
+        "turn_off_requested/2",
+        "power_key_down/0/" + std::to_string(second),
+        "power_button_press_signal/0/" + std::to_string(second)));
+}
+
+TEST(ATracer, exports_monotonic_timestamps)
+{
+    usc::Tracer tracer;
+
+    tracer.trace("first", 0);
+    tracer.trace("second", 0);
+
+    auto const json = tracer.chrome_trace_json();
+    std::regex const timestamp{"\"ts\":([0-9]+)"};
+    std::vector<long long> timestamps;
+    for (std::sregex_iterator iter{json.begin(), json.end(), timestamp}, end; iter != end; ++iter)
+        timestamps.push_back(std::stoll((*iter)[1].str()));
+
+    ASSERT_THAT(timestamps.size(), Eq(2u));
+    EXPECT_THAT(timestamps[1], Ge(timestamps[0]));
+}
+
+TEST(ATracerConstruction, rejects_zero_capacity)
+{
+    EXPECT_THROW({ usc::Tracer{0}; }, std::logic_error);
+}
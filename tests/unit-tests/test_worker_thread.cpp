@@ -0,0 +1,95 @@
+/*
+ * Copyright © 2017 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "src/worker_thread.h"
+
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <future>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace testing;
+
+TEST(AWorkerThread, runs_tasks_in_queue_order)
+{
+    std::vector<int> run;
+
+    {
+        usc::WorkerThread worker{"test"};
+        for (int i = 0; i < 5; ++i)
+            worker.queue([&run,i] { run.push_back(i); });
+    }
+
+    EXPECT_THAT(run, ElementsAre(0, 1, 2, 3, 4));
+}
+
+TEST(AWorkerThread, runs_tasks_on_a_thread_of_its_own)
+{
+    usc::WorkerThread worker{"test"};
+    std::promise<std::thread::id> task_thread;
+
+    worker.queue([&task_thread] { task_thread.set_value(std::this_thread::get_id()); });
+
+    EXPECT_THAT(task_thread.get_future().get(), Ne(std::this_thread::get_id()));
+}
+
+TEST(AWorkerThread, does_not_block_queueing_while_a_task_runs)
+{
+    std::promise<void> release;
+    auto released = release.get_future();
+    std::vector<int> run;
+
+    {
+        usc::WorkerThread worker{"test"};
+
+        worker.queue([&released, &run] { released.wait(); run.push_back(0); });
+        worker.queue([&run] { run.push_back(1); });
+
+        EXPECT_THAT(run, IsEmpty());
+        release.set_value();
+    }
+
+    EXPECT_THAT(run, ElementsAre(0, 1));
+}
+
+TEST(AWorkerThread, runs_queued_tasks_but_drops_later_ones_when_finished)
+{
+    std::promise<void> started;
+    std::promise<void> release;
+    auto released = release.get_future();
+    std::vector<int> run;
+
+    usc::WorkerThread worker{"test"};
+
+    worker.queue([&] { started.set_value(); released.wait(); run.push_back(0); });
+    worker.queue([&run] { run.push_back(1); });
+
+    started.get_future().wait();
+    auto finishing = std::async(std::launch::async, [&worker] { worker.finish(); });
+
+    // The running task holds up finish(), as does the one queued after it
+    EXPECT_EQ(std::future_status::timeout,
+              finishing.wait_for(std::chrono::milliseconds{50}));
+
+    release.set_value();
+    finishing.get();
+    worker.queue([&run] { run.push_back(2); });
+
+    EXPECT_THAT(run, ElementsAre(0, 1));
+}